@@ -0,0 +1,94 @@
+// cancel latency with a deep book: 1M+ resting orders, cancelled in random order
+// compares OrderBook::cancel (id decodes straight to a pool slot) against the cost of the
+// old locator alone - a node-based unordered_map<id, slot> find + erase per cancel,
+// then wipes the same book again in one cancel_all() (whole levels at a time)
+//
+// usage: bench_cancel [resting_orders=1000000] [seed=1]
+// build with -DCMAKE_BUILD_TYPE=Release, numbers from a Debug build mean nothing
+
+#include "OrderBook.hpp"
+#include <algorithm>     // std::shuffle, std::sort
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>       // strtoull
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // ns per op for each cancel, sorted, so percentiles are just an index
+    struct Samples {
+        std::vector<uint32_t> ns;
+        double pct(double p) const { return ns.empty() ? 0.0 : ns[static_cast<size_t>(p * (ns.size() - 1))]; }
+    };
+
+    void report(const char* name, Samples& s, double total_s) {
+        std::sort(s.ns.begin(), s.ns.end());
+        std::printf("%-22s ops=%zu  mean=%.1fns  p50=%.0fns  p99=%.0fns  p99.9=%.0fns  max=%uns\n",
+                    name, s.ns.size(), total_s * 1e9 / s.ns.size(), s.pct(0.50), s.pct(0.99), s.pct(0.999),
+                    s.ns.empty() ? 0u : s.ns.back());
+    }
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    const size_t   n    = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+    std::mt19937_64 rng(seed);
+
+    // build a deep, non-crossing bid book spread over 1000 levels
+    BookOptions opts;
+    opts.order_capacity = n;
+    OrderBook ob(opts);
+    std::vector<uint64_t> ids;
+    ids.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        ids.push_back(ob.add_limit(Side::Buy, /*px=*/10000 + static_cast<int64_t>(rng() % 1000), /*qty=*/1, i).order_id);
+    std::shuffle(ids.begin(), ids.end(), rng);
+
+    // 1) engine cancel: decode id -> slot, unlink, maybe drop the level
+    Samples book;
+    book.ns.reserve(n);
+    auto t0 = Clock::now();
+    for (uint64_t id : ids) {
+        auto a = Clock::now();
+        ob.cancel(id);
+        book.ns.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a).count()));
+    }
+    const double book_s = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    // 2) the previous locator on its own: hash + bucket chase + node free per cancel
+    std::unordered_map<uint64_t, uint32_t> id_to_handle;
+    for (size_t i = 0; i < n; ++i) id_to_handle.emplace(ids[i], static_cast<uint32_t>(i));
+    std::shuffle(ids.begin(), ids.end(), rng);
+    Samples map;
+    map.ns.reserve(n);
+    uint64_t sink = 0;
+    t0 = Clock::now();
+    for (uint64_t id : ids) {
+        auto a = Clock::now();
+        auto it = id_to_handle.find(id);
+        sink += it->second;
+        id_to_handle.erase(it);
+        map.ns.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a).count()));
+    }
+    const double map_s = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    // 3) mass cancel: refill the same book, then drop everything in one call
+    for (size_t i = 0; i < n; ++i) ob.add_limit(Side::Buy, /*px=*/10000 + static_cast<int64_t>(rng() % 1000), /*qty=*/1, i);
+    std::vector<uint64_t> cancelled;
+    cancelled.reserve(n);
+    t0 = Clock::now();
+    const size_t wiped = ob.cancel_all(&cancelled);
+    const double wipe_s = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    std::printf("resting orders: %zu (seed %llu)\n", n, static_cast<unsigned long long>(seed));
+    report("OrderBook::cancel", book, book_s);
+    report("unordered_map lookup", map, map_s);
+    std::printf("%-22s orders=%zu  total=%.2fms  (%.1fns/order; one-by-one cancel above: %.2fms)\n",
+                "OrderBook::cancel_all", wiped, wipe_s * 1e3, wipe_s * 1e9 / static_cast<double>(wiped), book_s * 1e3);
+    return sink == 0xFFFFFFFFFFFFFFFFull; // keep the map loop from being optimized away
+}
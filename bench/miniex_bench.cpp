@@ -0,0 +1,354 @@
+// matching-engine benchmark: synthetic order flow -> OrderBook, throughput + latency percentiles
+//
+// the whole command stream is generated up front from --seed (integer LCG, no <random>
+// distributions, whose output differs between standard libraries), so two runs with the same
+// flags feed the engine byte-identical flow and only the engine differs between them.
+// cancels only target orders still resting at that point of the flow (see generate()).
+// timing covers the OrderBook calls only (one steady_clock pair per op, ~20-40ns of overhead)
+//
+// usage: miniex_bench [--scenario=walk|poisson|cancel_heavy|sweep|deep] [--ops=N] [--seed=S]
+//                     [--levels=map|dense] [--prefill=N] [--cancel-ratio=R] [--sweep-prob=P]
+//                     [--cancel=eager|lazy] [--json]
+//   --json prints one machine-readable JSON object (for regression tracking) instead of the table
+// build with -DCMAKE_BUILD_TYPE=Release, numbers from a Debug build mean nothing
+
+#include "OrderBook.hpp"
+#include "../tests/TestUtil.hpp" // Lcg: the seeded integer generator the tests use (no <random> distributions)
+#include <algorithm>
+#include <bit>           // std::bit_width for histogram buckets
+#include <chrono>
+#include <cmath>         // std::log for exponential inter-arrival times
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // ---------------------------------------------------------------- latency histogram
+    // log-linear buckets (16 sub-buckets per power of two, ~6% resolution), fixed size,
+    // so recording is a couple of instructions and never allocates
+    class Histogram {
+    public:
+        void record(uint64_t ns) {
+            ++buckets_[index(ns)];
+            ++count_;
+            sum_ += ns;
+            max_ = std::max(max_, ns);
+        }
+        uint64_t count() const { return count_; }
+        uint64_t max()   const { return max_; }
+        double   mean()  const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+        // upper edge of the bucket holding the p-th percentile
+        uint64_t pct(double p) const {
+            if (count_ == 0) return 0;
+            const uint64_t want = static_cast<uint64_t>(p * static_cast<double>(count_ - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBuckets; ++i) {
+                seen += buckets_[i];
+                if (seen >= want) return std::min(upper(i), max_);
+            }
+            return max_;
+        }
+
+    private:
+        static constexpr size_t kSub = 16;
+        static constexpr size_t kBuckets = kSub + 60 * kSub;
+
+        static size_t index(uint64_t v) {
+            if (v < kSub) return static_cast<size_t>(v);
+            const size_t msb = std::bit_width(v) - 1;          // >= 4
+            const size_t sub = (v >> (msb - 4)) & (kSub - 1);
+            return std::min(kSub + (msb - 4) * kSub + sub, kBuckets - 1);
+        }
+        static uint64_t upper(size_t i) {
+            if (i < kSub) return i;
+            const size_t msb = (i - kSub) / kSub + 4;
+            const size_t sub = (i - kSub) % kSub;
+            return ((kSub + sub + 1) << (msb - 4)) - 1;
+        }
+
+        uint64_t buckets_[kBuckets] = {};
+        uint64_t count_ = 0, sum_ = 0, max_ = 0;
+    };
+
+    // ---------------------------------------------------------------- flow generation
+    enum class Op : uint8_t { AddLimit, AddMarket, Cancel };
+    constexpr const char* kOpNames[] = { "add_limit", "add_market", "cancel" };
+
+    struct GenOp {
+        Op       op;
+        Side     side;
+        int64_t  px_ticks;
+        int64_t  qty;
+        uint64_t ts;
+        uint64_t target;   // Cancel: index of an earlier AddLimit (resolved to its id at run time)
+    };
+
+    struct Params {
+        std::string scenario    = "walk";
+        uint64_t    ops         = 1000000;
+        uint64_t    seed        = 1;
+        LevelStore  levels      = LevelStore::Map;
+        bool        lazy_cancel = false;   // BookOptions::lazy_cancel (tombstones + batched compaction)
+        uint64_t    prefill     = 10000;   // passive orders resting before the timed run
+        double      cancel_ratio = 1.0;    // cancels per add
+        double      sweep_prob  = 0.01;    // chance an op is an aggressive sweep (market order or crossing limit)
+        int64_t     sweep_qty   = 200;     // size of a sweep (several levels deep)
+        double      arrival_rate = 1e6;    // Poisson arrivals per second of simulated time (drives ts)
+        double      walk_prob   = 0.05;    // chance the mid moves one tick per op
+        int64_t     book_width  = 50;      // passive orders land within this many ticks of the touch
+    };
+
+    // presets; any flag given after --scenario still overrides them
+    void apply_scenario(Params& p) {
+        if (p.scenario == "walk")              { p.walk_prob = 0.2; }
+        else if (p.scenario == "poisson")      { p.arrival_rate = 2e5; }
+        else if (p.scenario == "cancel_heavy") { p.cancel_ratio = 20.0; p.sweep_prob = 0.002; }
+        else if (p.scenario == "sweep")        { p.sweep_prob = 0.1; p.sweep_qty = 2000; }
+        else if (p.scenario == "deep")         { p.prefill = 1000000; p.book_width = 5000; }
+        else { std::fprintf(stderr, "unknown scenario %s\n", p.scenario.c_str()); std::exit(2); }
+    }
+
+    // prefill + timed ops, all decided up front from the seed
+    struct Flow {
+        std::vector<GenOp> prefill;
+        std::vector<GenOp> ops;
+    };
+
+    // adds still resting at the current point of the flow, in add order, so cancels can pick a
+    // live order (and lean towards recent ones). dead entries are dropped in batches
+    class LiveOrders {
+    public:
+        // the k-th add (k = adds so far) left `qty` resting (0: it never rested)
+        void added(int64_t qty) {
+            if (qty > 0) { order_.push_back(rem_.size()); ++live_; }
+            rem_.push_back(qty);
+        }
+        // true if that fill took the rest of it
+        bool filled(uint64_t k, int64_t qty) {
+            if ((rem_[k] -= qty) != 0) return false;
+            --live_;
+            return true;
+        }
+        void cancelled(uint64_t k)           { rem_[k] = 0; --live_; }
+        size_t size() const { return live_; }
+
+        // the live add at or just after position `from_newest` counted back from the newest
+        uint64_t pick(uint64_t from_newest) {
+            if (order_.size() > 2 * live_ + 64)
+                std::erase_if(order_, [this](uint64_t k) { return rem_[k] == 0; });
+            size_t i = order_.size() - 1 - std::min<size_t>(from_newest, order_.size() - 1);
+            for (size_t j = i; j < order_.size(); ++j) if (rem_[order_[j]] > 0) return order_[j];
+            while (rem_[order_[i]] == 0) --i;   // nothing newer is live: take the nearest older one
+            return order_[i];
+        }
+
+    private:
+        std::vector<uint64_t> order_;   // add indices, oldest first; may hold dead ones
+        std::vector<int64_t>  rem_;     // per add index: qty still resting
+        size_t                live_ = 0;
+    };
+
+    Flow generate(const Params& p) {
+        Lcg next{ p.seed };
+        auto u01 = [&next] { return static_cast<double>(next()) * 0x1p-31; };   // 31 bits -> [0, 1)
+        int64_t  mid = 100000;
+        double   t   = 0.0;          // simulated seconds
+        Flow f;
+        f.prefill.reserve(p.prefill);
+        f.ops.reserve(p.ops);
+
+        // the flow is run once here, untimed, on a book of its own: fills decide which adds are
+        // still resting, so every cancel targets a live order. matching does not depend on the
+        // book's options, so the timed book sees the same fills
+        OrderBook shadow;
+        std::vector<uint64_t> shadow_ids;                // add index -> shadow engine id
+        std::unordered_map<uint64_t, uint64_t> add_of;   // shadow id of a resting add -> add index
+        LiveOrders live;
+        int64_t taker_filled = 0;
+        auto on_fill = [&](const Trade& t) {
+            taker_filled += t.qty;
+            const auto it = add_of.find(t.maker_order_id);
+            if (live.filled(it->second, t.qty)) add_of.erase(it);
+        };
+        auto emit = [&](std::vector<GenOp>& out, const GenOp& g) {
+            out.push_back(g);
+            taker_filled = 0;
+            if (g.op == Op::AddLimit) {
+                const uint64_t id = shadow.add_limit(g.side, g.px_ticks, g.qty, g.ts, on_fill);
+                const int64_t rests = id ? g.qty - taker_filled : 0;
+                if (rests > 0) add_of.emplace(id, shadow_ids.size());
+                shadow_ids.push_back(id);
+                live.added(rests);
+            } else if (g.op == Op::AddMarket) {
+                shadow.add_market(g.side, g.qty, g.ts, on_fill);
+            } else {
+                shadow.cancel(shadow_ids[g.target]);
+                add_of.erase(shadow_ids[g.target]);
+                live.cancelled(g.target);
+            }
+        };
+
+        auto passive = [&](uint64_t ts) {
+            // bids below the mid, asks above (may still cross older quotes once the mid has moved)
+            const Side    side = u01() < 0.5 ? Side::Buy : Side::Sell;
+            const int64_t off  = 1 + static_cast<int64_t>(u01() * u01() * p.book_width); // denser near the touch
+            const int64_t px   = side == Side::Buy ? mid - off : mid + off;
+            return GenOp{ Op::AddLimit, side, px, 1 + static_cast<int64_t>(next() % 10), ts, 0 };
+        };
+
+        for (uint64_t i = 0; i < p.prefill; ++i) emit(f.prefill, passive(0));
+
+        const double p_cancel = p.cancel_ratio / (1.0 + p.cancel_ratio);
+        for (uint64_t i = 0; i < p.ops; ++i) {
+            t += -std::log(1.0 - u01()) / p.arrival_rate;   // Poisson process: exponential gaps
+            const uint64_t ts = static_cast<uint64_t>(t * 1e9);
+            if (u01() < p.walk_prob) mid += u01() < 0.5 ? -1 : 1;
+
+            const double r = u01();
+            if (r < p.sweep_prob) {
+                // aggressive: market order, or a sell limit priced through the bids (crosses)
+                const Side side = u01() < 0.5 ? Side::Buy : Side::Sell;
+                if (u01() < 0.5) emit(f.ops, GenOp{ Op::AddMarket, side, 0, p.sweep_qty, ts, 0 });
+                else             emit(f.ops, GenOp{ Op::AddLimit, Side::Sell, mid - p.book_width / 4, p.sweep_qty, ts, 0 });
+            } else if (live.size() > 0 && u01() < p_cancel) {
+                // cancel a resting order, biased to recent ones (most cancels hit fresh quotes)
+                const uint64_t back = static_cast<uint64_t>(u01() * u01() * static_cast<double>(live.size()));
+                emit(f.ops, GenOp{ Op::Cancel, Side::Buy, 0, 0, ts, live.pick(back) });
+            } else {
+                emit(f.ops, passive(ts));
+            }
+        }
+        return f;
+    }
+
+    // ---------------------------------------------------------------- run + report
+    struct Result {
+        Histogram hist[3];
+        uint64_t  trades = 0;
+        uint64_t  cancel_hits = 0;
+        double    seconds = 0.0;   // sum of timed op latencies
+        double    wall = 0.0;      // wall clock of the timed loop (incl. timer overhead)
+    };
+
+    Result run(const Params& p, const Flow& f) {
+        BookOptions opts;
+        opts.level_store    = p.levels;
+        opts.order_capacity = p.prefill + p.ops / 2;
+        opts.lazy_cancel    = p.lazy_cancel;
+        OrderBook ob(opts);
+
+        // adds are numbered in generation order; ids[k] = engine id of the k-th AddLimit
+        std::vector<uint64_t> ids;
+        ids.reserve(p.prefill + p.ops);
+        uint64_t trades = 0;
+        auto count = [&trades](const Trade&) { ++trades; };
+        for (const GenOp& g : f.prefill) ids.push_back(ob.add_limit(g.side, g.px_ticks, g.qty, g.ts, count));
+        trades = 0;
+
+        Result res;
+        const auto w0 = Clock::now();
+        for (const GenOp& g : f.ops) {
+            const auto a = Clock::now();
+            switch (g.op) {
+                case Op::AddLimit:  ids.push_back(ob.add_limit(g.side, g.px_ticks, g.qty, g.ts, count)); break;
+                case Op::AddMarket: ob.add_market(g.side, g.qty, g.ts, count); break;
+                case Op::Cancel:    res.cancel_hits += ob.cancel(ids[g.target]); break;
+            }
+            const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a).count());
+            res.hist[static_cast<size_t>(g.op)].record(ns);
+            res.seconds += static_cast<double>(ns) * 1e-9;
+        }
+        res.wall = std::chrono::duration<double>(Clock::now() - w0).count();
+        res.trades = trades;
+        return res;
+    }
+
+    // share of cancels that found their order still resting (the flow only targets live orders,
+    // so anything below 100% means the engine under test matched differently)
+    double hit_rate(const Result& r) {
+        const uint64_t n = r.hist[static_cast<size_t>(Op::Cancel)].count();
+        return n ? static_cast<double>(r.cancel_hits) / static_cast<double>(n) : 0.0;
+    }
+
+    void print_table(const Params& p, const Result& r) {
+        std::printf("scenario=%s levels=%s cancel=%s ops=%llu seed=%llu prefill=%llu cancel_ratio=%.1f sweep_prob=%.3f\n",
+                    p.scenario.c_str(), p.levels == LevelStore::Dense ? "dense" : "map", p.lazy_cancel ? "lazy" : "eager",
+                    static_cast<unsigned long long>(p.ops), static_cast<unsigned long long>(p.seed),
+                    static_cast<unsigned long long>(p.prefill), p.cancel_ratio, p.sweep_prob);
+        std::printf("total: %.0f ops/s (engine time), %.0f ops/s (wall), trades=%llu cancel_hits=%llu (%.1f%%)\n",
+                    static_cast<double>(p.ops) / r.seconds, static_cast<double>(p.ops) / r.wall,
+                    static_cast<unsigned long long>(r.trades), static_cast<unsigned long long>(r.cancel_hits),
+                    100.0 * hit_rate(r));
+        std::printf("%-11s %10s %12s %8s %8s %8s %8s %10s\n", "op", "count", "ops/s", "mean", "p50", "p99", "p99.9", "max(ns)");
+        for (size_t i = 0; i < 3; ++i) {
+            const Histogram& h = r.hist[i];
+            if (h.count() == 0) continue;
+            std::printf("%-11s %10llu %12.0f %8.0f %8llu %8llu %8llu %10llu\n", kOpNames[i],
+                        static_cast<unsigned long long>(h.count()), 1e9 / h.mean(), h.mean(),
+                        static_cast<unsigned long long>(h.pct(0.50)), static_cast<unsigned long long>(h.pct(0.99)),
+                        static_cast<unsigned long long>(h.pct(0.999)), static_cast<unsigned long long>(h.max()));
+        }
+    }
+
+    void print_json(const Params& p, const Result& r) {
+        std::printf("{\"scenario\":\"%s\",\"levels\":\"%s\",\"cancel\":\"%s\",\"ops\":%llu,\"seed\":%llu,\"prefill\":%llu,"
+                    "\"cancel_ratio\":%g,\"sweep_prob\":%g,\"ops_per_sec\":%.0f,\"trades\":%llu,\"cancel_hits\":%llu,\"cancel_hit_rate\":%.4f,\"per_op\":[",
+                    p.scenario.c_str(), p.levels == LevelStore::Dense ? "dense" : "map", p.lazy_cancel ? "lazy" : "eager",
+                    static_cast<unsigned long long>(p.ops), static_cast<unsigned long long>(p.seed),
+                    static_cast<unsigned long long>(p.prefill), p.cancel_ratio, p.sweep_prob,
+                    static_cast<double>(p.ops) / r.seconds,
+                    static_cast<unsigned long long>(r.trades), static_cast<unsigned long long>(r.cancel_hits), hit_rate(r));
+        bool first = true;
+        for (size_t i = 0; i < 3; ++i) {
+            const Histogram& h = r.hist[i];
+            if (h.count() == 0) continue;
+            std::printf("%s{\"op\":\"%s\",\"count\":%llu,\"ops_per_sec\":%.0f,\"mean_ns\":%.1f,\"p50_ns\":%llu,"
+                        "\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}",
+                        first ? "" : ",", kOpNames[i], static_cast<unsigned long long>(h.count()), 1e9 / h.mean(), h.mean(),
+                        static_cast<unsigned long long>(h.pct(0.50)), static_cast<unsigned long long>(h.pct(0.99)),
+                        static_cast<unsigned long long>(h.pct(0.999)), static_cast<unsigned long long>(h.max()));
+            first = false;
+        }
+        std::printf("]}\n");
+    }
+
+    // "--name=value" -> value if arg starts with --name=, else nullptr
+    const char* flag(const char* arg, const char* name) {
+        const size_t n = std::strlen(name);
+        return std::strncmp(arg, name, n) == 0 && arg[n] == '=' ? arg + n + 1 : nullptr;
+    }
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    Params p;
+    bool json = false;
+    // scenario first, so its preset can be overridden by the other flags
+    for (int i = 1; i < argc; ++i)
+        if (const char* v = flag(argv[i], "--scenario")) p.scenario = v;
+    apply_scenario(p);
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (const char* v = flag(a, "--ops"))               p.ops = std::strtoull(v, nullptr, 10);
+        else if (const char* v = flag(a, "--seed"))         p.seed = std::strtoull(v, nullptr, 10);
+        else if (const char* v = flag(a, "--prefill"))      p.prefill = std::strtoull(v, nullptr, 10);
+        else if (const char* v = flag(a, "--cancel-ratio")) p.cancel_ratio = std::strtod(v, nullptr);
+        else if (const char* v = flag(a, "--sweep-prob"))   p.sweep_prob = std::strtod(v, nullptr);
+        else if (const char* v = flag(a, "--levels"))       p.levels = std::strcmp(v, "dense") == 0 ? LevelStore::Dense : LevelStore::Map;
+        else if (const char* v = flag(a, "--cancel"))       p.lazy_cancel = std::strcmp(v, "lazy") == 0;
+        else if (std::strcmp(a, "--json") == 0)             json = true;
+        else if (!flag(a, "--scenario")) { std::fprintf(stderr, "unknown flag %s\n", a); return 2; }
+    }
+
+    const Flow   flow = generate(p);
+    const Result res  = run(p, flow);
+    if (json) print_json(p, res);
+    else      print_table(p, res);
+    return 0;
+}
@@ -0,0 +1,303 @@
+// offline replay of captured order flow: memory-maps an event file, drives one OrderBook with
+// it, optionally writes every trade out, and reports throughput + memory. this is how a
+// new engine build is qualified against real captures before rollout
+//
+// usage: miniex_replay <input> [--out=trades.csv] [--levels=map|dense] [--cancel=eager|lazy]
+//                      [--save-journal=path] [--json]
+//
+// input formats (picked from the first bytes of the file):
+//  - binary: a journal file exactly as Journal writes it (JournalHeader + Command records).
+//    cancel / amend records name the id the capturing engine assigned, which a fresh book
+//    hands out again, so ids line up; any record whose result differs is counted as a mismatch
+//    (exit code 3). ids depend on slot reuse, so replay with the --levels/--cancel the capture
+//    ran with: a lazy book keeps tombstoned slots longer and hands out different ids
+//  - csv, one event per line ('#' starts a comment line, blank lines are skipped):
+//      A,<B|S>,<px_ticks>,<qty>,<ts>[,<day|ioc|fok|post>]   add limit
+//      M,<B|S>,<qty>,<ts>                                   market
+//      C,<k>                                                cancel the k-th A line (0-based)
+//    --save-journal converts it to the binary format while replaying it
+// exit code 1 (and no report) if the input cannot be read or an output file cannot be written in full
+//
+// the file is parsed in place from the mapping: no per-line allocation, no copies. trades go
+// out as "maker,taker,px,qty,ts" lines through a 1MB buffer (one write() per buffer).
+// memory: the book's own footprint is OrderBook::memory_usage() at the end of the run (pools
+// never give capacity back unless the flow shrinks them, so that is its peak). process peak RSS
+// is printed too, but it counts every page of the mapped input the replay touched - for a big
+// capture that is nearly all of it, so it says little about the engine
+// build with -DCMAKE_BUILD_TYPE=Release, numbers from a Debug build mean nothing
+
+#include "OrderBook.hpp"
+#include "Journal.hpp"
+#include "MappedFile.hpp" // the input, mapped read-only
+#include <charconv>      // std::from_chars / std::to_chars: no locale, no allocation
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/resource.h> // getrusage: peak RSS
+#include <vector>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // trades -> text file through one fixed buffer. a null writer only counts. a short write
+    // (disk full) is remembered and reported by close(), which the caller must check
+    class TradeWriter {
+    public:
+        explicit TradeWriter(const char* path) {
+            if (!path) return;
+            f_ = std::fopen(path, "wb");
+            if (f_) std::setvbuf(f_, nullptr, _IONBF, 0); // we buffer ourselves
+            buf_.resize(1 << 20);
+        }
+        ~TradeWriter() { close(); }
+
+        bool ok(const char* path) const { return !path || f_; }
+
+        void operator()(const Trade& t) {
+            ++count_;
+            if (!f_) return;
+            if (used_ + kMaxLine > buf_.size()) flush();
+            char* p = buf_.data() + used_;
+            char* end = buf_.data() + buf_.size();
+            p = std::to_chars(p, end, t.maker_order_id).ptr; *p++ = ',';
+            p = std::to_chars(p, end, t.taker_order_id).ptr; *p++ = ',';
+            p = std::to_chars(p, end, t.px_ticks).ptr;       *p++ = ',';
+            p = std::to_chars(p, end, t.qty).ptr;            *p++ = ',';
+            p = std::to_chars(p, end, t.ts).ptr;             *p++ = '\n';
+            used_ = static_cast<size_t>(p - buf_.data());
+        }
+
+        // false if any trade did not make it to the file
+        bool close() {
+            if (!f_) return !failed_;
+            flush();
+            if (std::ferror(f_)) failed_ = true;
+            if (std::fclose(f_) != 0) failed_ = true;
+            f_ = nullptr;
+            return !failed_;
+        }
+        uint64_t count() const { return count_; }
+
+    private:
+        static constexpr size_t kMaxLine = 5 * 21; // five 64-bit numbers + separators
+
+        void flush() {
+            if (used_ && std::fwrite(buf_.data(), 1, used_, f_) != used_) failed_ = true;
+            used_ = 0;
+        }
+
+        std::FILE*        f_ = nullptr;
+        std::vector<char> buf_;
+        size_t            used_ = 0;
+        uint64_t          count_ = 0;
+        bool              failed_ = false;
+    };
+
+    struct Totals {
+        uint64_t events = 0;
+        uint64_t rejected = 0;    // csv: refused by the engine (incl. cancels of orders already gone)
+                                  // binary: result differs from the capture
+        uint64_t bad_lines = 0;   // csv lines that did not parse (skipped)
+    };
+
+    // binary: the records are read in place from the mapping
+    // (every record carries the id its command acked with - 0 for compact / range cancel / shrink)
+    void replay_binary(const detail::MappedFile& in, OrderBook& ob, TradeWriter& out, Totals& tot) {
+        const size_t n = (in.size() - sizeof(JournalHeader)) / sizeof(Command);
+        const auto* recs = reinterpret_cast<const Command*>(in.data() + sizeof(JournalHeader));
+        for (size_t i = 0; i < n; ++i) tot.rejected += ob.dispatch(recs[i], out).order_id != recs[i].order_id;
+        tot.events = n;
+    }
+
+    // ---------------------------------------------------------------- csv
+    // cursor over one line; every field is parsed straight out of the mapping
+    struct Fields {
+        const char* p;
+        const char* end;
+
+        bool next_char(char& out) {
+            if (p == end) return false;
+            out = *p++;
+            return p == end || *p++ == ',';
+        }
+        template <class T>
+        bool next_int(T& out) {
+            auto [q, ec] = std::from_chars(p, end, out);
+            if (ec != std::errc{}) return false;
+            p = q;
+            return p == end || *p++ == ',';
+        }
+        bool next_word(const char*& w, size_t& len) {
+            w = p;
+            while (p != end && *p != ',') ++p;
+            len = static_cast<size_t>(p - w);
+            if (p != end) ++p;
+            return len > 0;
+        }
+    };
+
+    bool parse_side(char c, Side& side) {
+        if (c == 'B' || c == 'b') { side = Side::Buy;  return true; }
+        if (c == 'S' || c == 's') { side = Side::Sell; return true; }
+        return false;
+    }
+
+    bool parse_type(const char* w, size_t len, LimitType& t) {
+        auto is = [&](const char* s) { return len == std::strlen(s) && std::memcmp(w, s, len) == 0; };
+        if (is("day"))  { t = LimitType::Day;      return true; }
+        if (is("ioc"))  { t = LimitType::IOC;      return true; }
+        if (is("fok"))  { t = LimitType::FOK;      return true; }
+        if (is("post")) { t = LimitType::PostOnly; return true; }
+        return false;
+    }
+
+    // one csv line -> Command. cancels name the k-th add; `adds` maps that to its engine id
+    bool parse_line(const char* b, const char* e, const std::vector<uint64_t>& adds, Command& c) {
+        Fields f{ b, e };
+        char kind = 0, side = 0;
+        if (!f.next_char(kind)) return false;
+        c = Command{};
+        switch (kind) {
+            case 'A': {
+                c.type = CommandType::AddLimit;
+                if (!f.next_char(side) || !parse_side(side, c.side)) return false;
+                if (!f.next_int(c.px_ticks) || !f.next_int(c.qty) || !f.next_int(c.ts)) return false;
+                const char* w; size_t len;
+                if (f.p != f.end && (!f.next_word(w, len) || !parse_type(w, len, c.limit_type))) return false;
+                return true;
+            }
+            case 'M':
+                c.type = CommandType::AddMarket;
+                return f.next_char(side) && parse_side(side, c.side) && f.next_int(c.qty) && f.next_int(c.ts);
+            case 'C': {
+                c.type = CommandType::Cancel;
+                uint64_t k = 0;
+                if (!f.next_int(k) || k >= adds.size()) return false;
+                c.order_id = adds[k];
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    void replay_csv(const detail::MappedFile& in, OrderBook& ob, TradeWriter& out, Totals& tot) {
+        // engine id of every A line so far (0 = rejected); the only growing structure, and it
+        // grows by doubling, not per line
+        std::vector<uint64_t> adds;
+        adds.reserve(in.size() / 16);
+        const char* p   = in.data();
+        const char* end = in.data() + in.size();
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            const char* e  = nl ? nl : end;
+            const char* line_end = (e > p && e[-1] == '\r') ? e - 1 : e;
+            if (line_end > p && *p != '#') {
+                Command c;
+                if (parse_line(p, line_end, adds, c)) {
+                    const CommandAck ack = ob.dispatch(c, out);
+                    if (c.type == CommandType::AddLimit) adds.push_back(ack.order_id);
+                    tot.rejected += !ack.ok;
+                    ++tot.events;
+                } else {
+                    ++tot.bad_lines;
+                    if (*p == 'A') adds.push_back(0); // keep the numbering of later cancels intact
+                }
+            }
+            p = e + 1;
+        }
+    }
+
+    // "--name=value" -> value if arg starts with --name=, else nullptr
+    const char* flag(const char* arg, const char* name) {
+        const size_t n = std::strlen(name);
+        return std::strncmp(arg, name, n) == 0 && arg[n] == '=' ? arg + n + 1 : nullptr;
+    }
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    const char* out_path = nullptr;
+    const char* journal_path = nullptr;
+    bool json = false;
+    BookOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        if (const char* v = flag(a, "--out"))               out_path = v;
+        else if (const char* v = flag(a, "--save-journal")) journal_path = v;
+        else if (const char* v = flag(a, "--levels"))       opts.level_store = std::strcmp(v, "dense") == 0 ? LevelStore::Dense : LevelStore::Map;
+        else if (const char* v = flag(a, "--cancel"))       opts.lazy_cancel = std::strcmp(v, "lazy") == 0;
+        else if (std::strcmp(a, "--json") == 0)             json = true;
+        else if (a[0] != '-' && !input)                     input = a;
+        else { std::fprintf(stderr, "unknown argument %s\n", a); return 2; }
+    }
+    if (!input) {
+        std::fprintf(stderr, "usage: miniex_replay <input> [--out=trades.csv] [--levels=map|dense] "
+                             "[--cancel=eager|lazy] [--save-journal=path] [--json]\n");
+        return 2;
+    }
+
+    const detail::MappedFile in(input);
+    if (!in.ok()) { std::fprintf(stderr, "cannot map %s\n", input); return 1; }
+    // a journal starts with its header; anything else is read as csv
+    JournalHeader h{};
+    if (in.size() >= sizeof(h)) std::memcpy(&h, in.data(), sizeof(h));
+    const bool binary = std::memcmp(h.magic, "MNXJRNL", 8) == 0;
+    if (binary && (h.version != Journal::kVersion || h.record_size != sizeof(Command))) {
+        std::fprintf(stderr, "%s: journal written by an incompatible build\n", input);
+        return 1;
+    }
+
+    TradeWriter out(out_path);
+    if (!out.ok(out_path)) { std::fprintf(stderr, "cannot write %s\n", out_path); return 1; }
+    OrderBook ob(opts);
+    Journal journal;
+    if (journal_path) {
+        if (!journal.open(journal_path)) { std::fprintf(stderr, "cannot open journal %s\n", journal_path); return 1; }
+        ob.attach_journal(&journal);
+    }
+
+    Totals tot;
+    const auto t0 = Clock::now();
+    if (binary) replay_binary(in, ob, out, tot);
+    else        replay_csv(in, ob, out, tot);
+    const bool out_ok = out.close();
+    const double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    ob.attach_journal(nullptr);
+    journal.close();
+    // a truncated output is worse than none: fail loudly instead of reporting numbers
+    if (!out_ok) { std::fprintf(stderr, "write to %s failed: trade output is incomplete\n", out_path); return 1; }
+    if (journal_path && (journal.failed() || journal.dropped() != 0)) {
+        std::fprintf(stderr, "write to %s failed: journal is incomplete\n", journal_path);
+        return 1;
+    }
+
+    rusage ru{};
+    ::getrusage(RUSAGE_SELF, &ru);
+    const double peak_mb  = static_cast<double>(ru.ru_maxrss) / 1024.0; // KiB on Linux; mapped input included
+    const double input_mb = static_cast<double>(in.size()) / (1 << 20);
+    const double eps = static_cast<double>(tot.events) / secs;
+    const double tps = static_cast<double>(out.count()) / secs;
+    const double book_kb = static_cast<double>(ob.memory_usage().total()) / 1024.0;
+
+    if (json) {
+        std::printf("{\"input\":\"%s\",\"format\":\"%s\",\"events\":%llu,\"trades\":%llu,\"seconds\":%.6f,"
+                    "\"events_per_sec\":%.0f,\"trades_per_sec\":%.0f,\"book_kb\":%.0f,\"peak_rss_mb\":%.1f,\"input_mb\":%.1f,\"rejected\":%llu,\"bad_lines\":%llu}\n",
+                    input, binary ? "binary" : "csv", static_cast<unsigned long long>(tot.events),
+                    static_cast<unsigned long long>(out.count()), secs, eps, tps, book_kb, peak_mb, input_mb,
+                    static_cast<unsigned long long>(tot.rejected), static_cast<unsigned long long>(tot.bad_lines));
+    } else {
+        std::printf("input=%s format=%s size=%.1fMB\n", input, binary ? "binary" : "csv", input_mb);
+        std::printf("events=%llu trades=%llu in %.3fs\n", static_cast<unsigned long long>(tot.events),
+                    static_cast<unsigned long long>(out.count()), secs);
+        std::printf("%.0f events/s, %.0f trades/s\n", eps, tps);
+        std::printf("book memory %.0fKB (memory_usage), process peak RSS %.1fMB incl. the %.1fMB mapped input\n",
+                    book_kb, peak_mb, input_mb);
+        std::printf("%s=%llu bad_lines=%llu\n", binary ? "mismatches" : "rejected",
+                    static_cast<unsigned long long>(tot.rejected), static_cast<unsigned long long>(tot.bad_lines));
+    }
+    // a binary capture must replay exactly; anything else is a failed qualification
+    return binary && tot.rejected != 0 ? 3 : 0;
+}
@@ -0,0 +1,59 @@
+// many instruments in one process: one OrderBook per symbol, routed by symbol id
+// callers hold symbol ids (small dense integers handed out by the gateway / refdata),
+// not book pointers, so routing has to be a plain array index - no hashing on the hot path
+
+#pragma once
+
+#include "OrderBook.hpp"
+#include <cstddef>   // size_t
+#include <cstdint>   // uint32_t
+#include <deque>     // book storage: growing it never moves existing books
+#include <vector>    // the symbol -> slot table
+
+// one command addressed to a book: the same Command apply_batch takes, plus the symbol.
+// the unit of the multi-book paths (Sequencer rings, parallel replay input)
+struct SymbolCommand {
+    uint32_t symbol_id;
+    Command  cmd;
+};
+
+/*
+ * BookManager owns the books. Lookup is O(1):
+ *   symbol_id -> slot_of_[symbol_id] -> books_[slot]
+ * books_ is a deque in registration order: adding symbols never moves a book, so every
+ * OrderBook& / OrderBook* handed out stays valid for the manager's lifetime.
+ * what is (and is not) contiguous: the OrderBook handles - one pointer each - sit in the
+ * deque's blocks in registration order; each book's state (levels, order slab, ladders)
+ * is its own heap allocation behind that pointer, so books are not laid out next to each other.
+ */
+class BookManager {
+public:
+    static constexpr uint32_t kNoSlot = UINT32_MAX; // routing table entry for unknown symbols
+
+    // expected_symbols: sizes the routing tables up front (books never move either way)
+    explicit BookManager(size_t expected_symbols = 0);
+
+    // create the book for symbol_id (or return the existing one; the reference stays valid
+    // however many symbols are added later). symbol ids are expected
+    // to be dense-ish small integers; the routing table grows to the largest id seen
+    // opts only apply when the book is created
+    OrderBook& add_symbol(uint32_t symbol_id, const BookOptions& opts = {});
+
+    // O(1) routing; nullptr if the symbol was never added
+    OrderBook*       find(uint32_t symbol_id);
+    const OrderBook* find(uint32_t symbol_id) const;
+    // slot (index into book_at) of symbol_id's book; kNoSlot if the symbol was never added
+    uint32_t slot_of(uint32_t symbol_id) const {
+        return symbol_id < slot_of_.size() ? slot_of_[symbol_id] : kNoSlot;
+    }
+
+    size_t   size() const { return books_.size(); }
+    // books in registration order (slot 0..size()-1), e.g. for end-of-day sweeps
+    OrderBook& book_at(size_t slot) { return books_[slot]; }
+    uint32_t   symbol_at(size_t slot) const { return symbol_of_[slot]; }
+
+private:
+    std::vector<uint32_t>  slot_of_;   // symbol_id -> index into books_ (kNoSlot if absent)
+    std::deque<OrderBook>  books_;     // one book per symbol; stable addresses
+    std::vector<uint32_t>  symbol_of_; // index into books_ -> symbol_id
+};
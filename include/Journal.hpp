@@ -0,0 +1,92 @@
+// write-ahead journal: every accepted command, appended in binary, so a book can be
+// rebuilt after a crash by replaying the file (see Journal::replay)
+//
+// file layout (native endianness - written and read on the same architecture):
+//   JournalHeader  (16 bytes: magic, version, record size)
+//   Command[]      (48 bytes each, exactly the struct from OrderBook.hpp; order_id holds
+//                   the id the engine assigned, so replay can check it gets the same one)
+// a partially written last record (crash mid-write) is ignored on replay, and cut off when
+// open() appends to the file again
+
+#pragma once
+
+#include "OrderBook.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>   // memcpy into the staging buffer
+#include <string>
+#include <vector>
+
+struct JournalOptions {
+    size_t   buffer_bytes = 1 << 20; // records are staged here, one write() when it fills up
+    uint32_t fsync_every  = 0;       // fsync after this many records; 0 = only on sync() / close()
+};
+
+struct JournalHeader {
+    char     magic[8];     // "MNXJRNL" + '\0'
+    uint32_t version;      // bump when Command's layout changes
+    uint32_t record_size;  // sizeof(Command) when written
+};
+
+// result of replaying a journal into a book
+struct JournalReplay {
+    bool     ok = false;        // file opened, header valid
+    uint64_t records = 0;       // commands applied
+    uint64_t mismatches = 0;    // commands whose result differed from the journal (should be 0)
+};
+
+class Journal {
+public:
+    static constexpr uint32_t kVersion = 3;   // 2: CommandType::Amend records, 3: Command::limit_type
+
+    Journal() = default;
+    ~Journal();                 // flushes + fsyncs whatever is still buffered
+    Journal(const Journal&)            = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // open (or create) the file for appending; a new file gets a header. false on I/O error
+    // or if an existing file's header does not match this build
+    bool open(const std::string& path, const JournalOptions& opts = {});
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+
+    // stage one accepted command. cheap: a memcpy, plus a write() when the buffer fills.
+    // false if the buffer is full and could not be written out (disk full, I/O error): the
+    // record is not logged, and counts in dropped() instead of records()
+    bool append(const Command& c) {
+        if (fd_ < 0) return false;   // not open: nothing to log to
+        if (used_ + sizeof(Command) > buf_.size()) flush();
+        // a partial write still makes room; only a buffer that stayed full refuses the record
+        if (used_ + sizeof(Command) > buf_.size()) { ++dropped_; return false; }
+        std::memcpy(buf_.data() + used_, &c, sizeof(Command));
+        used_ += sizeof(Command);
+        ++records_;
+        if (opts_.fsync_every && ++since_sync_ >= opts_.fsync_every) sync();
+        return true;
+    }
+
+    // hand buffered records to the OS (write). on error the unwritten bytes stay buffered and
+    // the next flush() / sync() / append() retries them; false until everything is written
+    bool flush();
+    bool sync();    // flush + fsync: durable on return
+
+    uint64_t records() const { return records_; }   // records staged since open() (written or still buffered)
+    uint64_t dropped() const { return dropped_; }   // records append() refused since open(): the log has a gap
+    bool     failed() const  { return failed_; }    // the last flush could not write everything
+
+    // rebuild a book from a journal: mmap the file and feed the records through
+    // apply_batch in large chunks (no parsing, no per-event allocation).
+    // book should start empty. if book has a journal attached, the replayed
+    // commands are written to it again
+    static JournalReplay replay(const std::string& path, OrderBook& book);
+
+private:
+    int               fd_ = -1;
+    JournalOptions    opts_;
+    std::vector<char> buf_;          // preallocated staging buffer
+    size_t            used_ = 0;     // bytes staged in buf_
+    uint64_t          records_ = 0;  // records appended since open()
+    uint64_t          dropped_ = 0;  // records refused because the buffer could not be flushed
+    uint32_t          since_sync_ = 0;
+    bool              failed_ = false;
+};
@@ -0,0 +1,43 @@
+// read-only memory mapping of a whole file (POSIX mmap), unmapped on destruction
+// used by journal replay and snapshot restore to read records in place, and by the offline
+// replay tool (bench/miniex_replay) to parse captures straight out of the mapping
+#pragma once
+
+#include <cstddef>
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap / munmap / madvise
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close
+
+namespace detail {
+
+    class MappedFile {
+    public:
+        explicit MappedFile(const char* path) {
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0) return;
+            struct stat sb{};
+            if (::fstat(fd, &sb) == 0 && sb.st_size > 0) {
+                void* p = ::mmap(nullptr, static_cast<size_t>(sb.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    data_ = static_cast<const char*>(p);
+                    size_ = static_cast<size_t>(sb.st_size);
+                    ::madvise(p, size_, MADV_SEQUENTIAL); // read front to back, let the kernel read ahead
+                }
+            }
+            ::close(fd); // the mapping keeps the file alive
+        }
+        ~MappedFile() { if (data_) ::munmap(const_cast<char*>(data_), size_); }
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool        ok()   const { return data_ != nullptr; }  // false: missing, empty, or mmap failed
+        const char* data() const { return data_; }              // page-aligned
+        size_t      size() const { return size_; }
+
+    private:
+        const char* data_ = nullptr;
+        size_t      size_ = 0;
+    };
+
+} // namespace detail
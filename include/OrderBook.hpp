@@ -12,8 +12,14 @@ avoids double inclusion problem (same header gets pulled in multiple times)
 */
 #pragma once 
 
+#include <cstddef>   // size_t
+#include <concepts>  // std::invocable for TradeSink
 #include <cstdint>   // fixed-width ints
+#include <memory>    // std::unique_ptr for the pimpl, std::addressof
 #include <optional>  // std::optional for “maybe a value”
+#include <span>      // std::span for command batches
+#include <string>    // file paths for snapshot / restore
+#include <type_traits> // std::remove_cvref_t
 #include <vector>    // std::vector for trade lists
 
 // STRUCT - default to public members/inheritance, used for plain data carriers where all fields r public
@@ -39,6 +45,14 @@ struct Trade {
     uint64_t ts;              // trade timestamp (monotonic)
 };
 
+// what a limit order does with liquidity it can take now and with whatever is left after that
+enum class LimitType : uint8_t {
+    Day,      // trade what crosses, rest the remainder (plain limit order)
+    IOC,      // immediate-or-cancel: trade what crosses, drop the remainder - never rests
+    FOK,      // fill-or-kill: trade the whole qty right now, or nothing at all (rejected, book untouched)
+    PostOnly, // rest only: rejected (no trades, book untouched) if it would cross on arrival
+};
+
 // when submitting an action
 // need engine-generated id and list of trades it caused
 struct AddLimitResult {
@@ -51,6 +65,161 @@ struct AddMarketResult {
     std::vector<Trade> trades;         // may be empty
 };
 
+struct AmendResult {
+    bool               ok;     // false: unknown / inactive id, or invalid qty / price
+    std::vector<Trade> trades; // a re-priced order can cross; empty otherwise
+};
+
+// where fills go on the allocation-free path: a non-owning reference to any callable
+// taking (const Trade&) - a lambda, a functor writing into a caller-owned ring, etc.
+// the engine calls it once per fill, in match order, while the order is being matched.
+// it only stores a pointer to the callable, so the callable must outlive the call it is passed to
+// (a lambda written inline in the call is fine)
+class TradeSink {
+public:
+    template <class F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, TradeSink>) && std::invocable<F&, const Trade&>
+    TradeSink(F&& f) noexcept
+        : ctx_(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+          fn_([](void* ctx, const Trade& t) { (*static_cast<std::remove_reference_t<F>*>(ctx))(t); }) {}
+
+    void operator()(const Trade& t) const { fn_(ctx_, t); }
+
+private:
+    void* ctx_;                           // the caller's callable
+    void (*fn_)(void*, const Trade&);     // calls it with the right type
+};
+
+// L2 market data: one price level's new state after a command. agg_qty == 0 means the level is gone
+struct LevelUpdate {
+    Side     side;
+    int64_t  px_ticks;
+    int64_t  agg_qty;   // total resting quantity now at (side, px_ticks)
+    uint64_t seq;       // per book, +1 per update, no gaps - a publisher can detect drops downstream
+};
+
+// where L2 updates go: after every command that changed the book, the sink gets one batch with
+// each changed level exactly once (a sweep across ten levels = one batch of ten, not a flood).
+// non-owning like TradeSink, but the book keeps it until detached, so it only binds to a named
+// callable (an lvalue) that must outlive the book or be detached first
+class LevelSink {
+public:
+    template <class F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, LevelSink>) && std::invocable<F&, std::span<const LevelUpdate>>
+    LevelSink(F& f) noexcept
+        : ctx_(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+          fn_([](void* ctx, std::span<const LevelUpdate> u) { (*static_cast<F*>(ctx))(u); }) {}
+
+    void operator()(std::span<const LevelUpdate> u) const { fn_(ctx_, u); }
+
+private:
+    void* ctx_;
+    void (*fn_)(void*, std::span<const LevelUpdate>);
+};
+
+// where price levels are stored - chosen per book so both can be benchmarked on the same flow
+enum class LevelStore {
+    Map,   // std::map (red-black tree): O(log L) per lookup, any price range
+    Dense, // flat array indexed by (px_ticks - base) + occupancy bitmap around the touch,
+           // sparse map fallback for far-away prices
+};
+
+// construction-time knobs for one book
+struct BookOptions {
+    LevelStore level_store        = LevelStore::Map;
+    uint32_t   dense_window_ticks = 4096; // Dense only: ticks covered by the array (rounded up to 64)
+    size_t     order_capacity     = 0;    // resting orders to preallocate node slots for (grows past it on demand).
+                                          // one slot more is reserved on top: an incoming order holds a slot for
+                                          // its id while it matches (market, IOC, fully filled limit included),
+                                          // so a book that never rests more than this never grows its slab
+    // lazy cancel: cancel() only retires the id and takes the qty off the level; the node stays
+    // queued as a tombstone and is unlinked later - when matching reaches it, when its level
+    // empties, when its level's queue is compacted (see compact_min), or on compact().
+    // ids then depend on when compaction ran: replay a journal into a book with the same options
+    bool       lazy_cancel        = false;
+    uint32_t   compact_min        = 16;   // lazy_cancel only: a level's queue is compacted in one walk once it
+                                          // holds this many tombstones and they are at least half of it
+};
+
+// order-node allocator numbers, for sizing order_capacity in production
+struct PoolStats {
+    size_t live;       // slots holding resting orders right now
+    size_t capacity;   // slots allocated (live + free list)
+    size_t high_water; // most slots ever live at once
+    size_t tombstones = 0; // lazy cancel: of `live`, cancelled orders still waiting for compaction
+};
+
+// bytes held by one book's containers, pooled (free) capacity included. map nodes are
+// estimated from their usual layout; allocator overhead is not visible from here
+struct MemoryUsage {
+    size_t orders;      // order-node slab, live + free slots. this is also the id index: an id
+                        // carries its slot number, so there is no separate id -> order table
+    size_t levels;      // Level slab, live + recycled levels
+    size_t price_index; // both ladders: map nodes (live + recycled) or dense window arrays + far map
+    size_t scratch;     // per-command buffers: L2 batch, depth caches, mass-cancel scratch
+    size_t total() const { return orders + levels + price_index + scratch; }
+};
+
+// batch interface: a gateway packet becomes a span of Commands applied in one call
+enum class CommandType : uint8_t { AddLimit, AddMarket, Cancel, Amend, Compact, CancelRange, Shrink };
+
+// one command in a batch. plain fixed-layout struct (48 bytes) so a packet can be
+// handed over as-is; fields a command type does not use are ignored
+struct Command {
+    CommandType type;
+    Side        side;      // AddLimit / AddMarket / CancelRange
+    int64_t     px_ticks;  // AddLimit / Amend: new price. CancelRange: lowest price
+    int64_t     qty;       // AddLimit / AddMarket / Amend: new remaining qty. CancelRange: highest price
+    uint64_t    ts;        // AddLimit / AddMarket / Amend
+    uint64_t    order_id;  // Cancel / Amend: order to cancel / amend (Compact / Shrink use no fields)
+    LimitType   limit_type = LimitType::Day; // AddLimit (last, so existing 6-field initializers still mean Day)
+};
+
+// per-command result, written in the same order as the commands
+struct CommandAck {
+    uint64_t order_id;    // AddLimit: assigned id, AddMarket: taker id, Cancel / Amend: the order's id,
+                          // Compact / CancelRange / Shrink: 0. 0 = rejected (except those three, which are always ok)
+    uint32_t first_trade; // this command's trades are ResultSink::trades[first_trade, first_trade + trade_count)
+    uint32_t trade_count;
+    bool     ok;          // false: rejected add, or cancel of an unknown / inactive id
+};
+
+// caller-owned output of apply_batch. reuse the same sink across batches:
+// clear() keeps the capacity, so a warmed-up sink never allocates
+struct ResultSink {
+    std::vector<CommandAck> acks;   // one per command
+    std::vector<Trade>      trades; // every fill of the batch, contiguous, in match order
+    void clear() { acks.clear(); trades.clear(); }
+};
+
+// engine counters, see OrderBook::stats(). latency is in ticks of the cpu's cycle counter
+// (TSC on x86, the virtual counter on arm64) - compare runs on the same machine only
+inline constexpr size_t kLatencyBuckets = 32;
+struct LatencyHistogram {
+    uint64_t buckets[kLatencyBuckets]; // bucket i: ops that took [2^(i-1), 2^i) ticks (bucket 0: 0 ticks)
+    uint64_t count;                    // total ops recorded
+};
+
+struct BookStats {
+    bool enabled; // built with MINIEX_STATS: counters + histograms below are live; otherwise they are 0
+
+    LatencyHistogram add_limit, add_market, cancel, amend;
+    uint64_t aggressive_orders;   // orders that reached the matching loop (crossing limits + markets)
+    uint64_t levels_touched;      // price levels visited, summed over aggressive orders
+    uint64_t max_levels_touched;  // most levels a single order swept
+    uint64_t trades;              // trades emitted
+    uint64_t max_trades;          // most trades a single order emitted
+    uint64_t cancel_hits;         // cancels of a resting order
+    uint64_t cancel_misses;       // cancels of an unknown / already-gone id
+
+    // gauges: current book shape
+    uint64_t resting_orders;
+    uint64_t bid_levels;
+    uint64_t ask_levels;
+};
+
+class Journal; // Journal.hpp - write-ahead log of accepted commands
+
 /* 
  * public API the tests will call  
  * defines the functions/etc from part1.md Part B  
@@ -58,25 +227,124 @@ struct AddMarketResult {
  */
 class OrderBook {
 public:
+    // not thread-safe: a book belongs to one thread at a time. to feed it from several
+    // gateway threads, put it behind a Sequencer (Sequencer.hpp) instead of a mutex
+    // each book owns its own state (levels, queues, id index) - two books never see each other's orders
+    OrderBook();
+    explicit OrderBook(const BookOptions& opts);
+    ~OrderBook();
+    // move-only: the state lives behind a unique_ptr. a moved-from book must not be used again
+    OrderBook(OrderBook&&) noexcept;
+    OrderBook& operator=(OrderBook&&) noexcept;
+    OrderBook(const OrderBook&)            = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
+
     // order_id is engine generated for uniqueness, avoids client races
     // engine owns lifecycle, can attribute trades determinstically etc 
     // it makes logical sense that the client does not generate their own ids
     // can still return id so caller can cancel later.
-    AddLimitResult  add_limit (Side side, int64_t px_ticks, int64_t qty, uint64_t ts);
+    // ids are opaque (they encode where the order lives + a generation counter, so cancel is
+    // one array access) - unique among live orders, never 0, not ordered by arrival
+
+    // IOC / FOK / post-only via `type`. a FOK or post-only order that cannot be accepted is
+    // rejected (id 0) after a read-only look at the opposite side: no trades, nothing allocated,
+    // nothing journaled. an IOC that traded nothing is still accepted (it just never rests)
+    AddLimitResult  add_limit (Side side, int64_t px_ticks, int64_t qty, uint64_t ts, LimitType type = LimitType::Day);
     // no px_ticks bc has no price limit - can trade across multiple price levels, no single order price to pass in
     AddMarketResult add_market(Side side, int64_t qty, uint64_t ts);
 
+    // hot-path versions of the two above: fills are streamed into on_trade as they happen,
+    // nothing is allocated. return the order / taker id (0 = rejected)
+    // the vector-returning versions are thin wrappers over these
+    uint64_t add_limit (Side side, int64_t px_ticks, int64_t qty, uint64_t ts, TradeSink on_trade,
+                        LimitType type = LimitType::Day);
+    uint64_t add_market(Side side, int64_t qty, uint64_t ts, TradeSink on_trade);
+
     bool cancel(uint64_t order_id);
 
+    // mass cancel (risk events, dropped sessions): whole price levels are dropped in one pass -
+    // each queue is walked once to retire its ids - instead of one cancel() per order.
+    // returns how many orders were cancelled; their ids are appended to *cancelled if given, in no
+    // particular order. cancel_range is inclusive: [px_lo, px_hi]
+    size_t cancel_all(std::vector<uint64_t>* cancelled = nullptr);
+    size_t cancel_side(Side side, std::vector<uint64_t>* cancelled = nullptr);
+    size_t cancel_range(Side side, int64_t px_lo, int64_t px_hi, std::vector<uint64_t>* cancelled = nullptr);
+
+    // lazy_cancel books: unlink every tombstone now (e.g. while the market is quiet) instead of
+    // at the next threshold. returns how many were reclaimed; no-op (and 0) on an eager book
+    size_t compact();
+
+    // give pooled memory back after a busy session: recycled levels and map nodes, scratch
+    // capacity, and the free order slots past the highest one still in use (never below
+    // BookOptions::order_capacity + 1). compacts first on a lazy book. returns bytes released.
+    // which slots exist decides the ids of future orders, so this is journaled like compact()
+    size_t shrink();
+
+    // change a resting order in place, keeping its id. new_qty is the new remaining quantity.
+    //  - same price, qty down (or unchanged): shrinks in place, keeps its FIFO position
+    //  - qty up or a new price: moves to the tail of the new level with ts as its new time
+    //    priority; a new price that crosses matches first, exactly like add_limit at that price
+    // the node is relinked, never freed and re-acquired. false (book unchanged) on an unknown /
+    // inactive id, new_qty <= 0 or new_px < 0 - to pull an order, cancel it
+    AmendResult amend(uint64_t order_id, int64_t new_qty, int64_t new_px, uint64_t ts);
+    // hot-path version: fills streamed into on_trade, nothing allocated
+    bool        amend(uint64_t order_id, int64_t new_qty, int64_t new_px, uint64_t ts, TradeSink on_trade);
+
+    // apply a whole burst in one call, in order. appends one ack per command (and their
+    // trades) to out - same results as calling add_limit / add_market / cancel / amend one by one
+    void apply_batch(std::span<const Command> cmds, ResultSink& out);
+    // one command of any type, fills streamed into on_trade: what apply_batch does per command,
+    // for drivers that take commands one at a time. the ack's first_trade / trade_count are
+    // left 0 - only the caller knows where its trades went
+    CommandAck dispatch(const Command& c, TradeSink on_trade);
+
+    // save every resting order (price levels, FIFO order, ids) to a flat binary file.
+    // written beside it (path + ".tmp"), fsynced and renamed over path, so an existing snapshot
+    // is only replaced by a complete one. false on I/O error (path is then left as it was)
+    bool snapshot(const std::string& path) const;
+    // replace this book's contents with a snapshot: the mapped file is bulk-loaded level by level.
+    // resting ids stay valid, and new orders get the same ids the saved book would have given.
+    // false if the file is missing or not a valid snapshot - the book is then left unchanged
+    bool restore(const std::string& path);
+
+    // log every accepted command (with its assigned id) to j from now on; nullptr stops logging.
+    // the book does not own the journal - it must outlive the book or be detached first.
+    // a write error does not stop the book: check j->failed() / j->dropped() to notice it
+    void attach_journal(Journal* j);
+
+    // publish L2 deltas to sink from now on (see LevelSink); replaces any previous sink.
+    // restore() does not publish - re-send a full depth picture after it
+    void attach_level_sink(LevelSink sink);
+    void detach_level_sink();
+
     //
     std::optional<TopOfBook> best_bid() const;
     std::optional<TopOfBook> best_ask() const;
 
     int64_t depth_at(Side side, int64_t px_ticks) const;
 
+    // best min(n, out.size()) levels of one side, best first; returns how many were written.
+    // served from a cached copy of the top levels that only gets rebuilt after a level inside
+    // it appears or disappears - repeated snapshots of a quiet top of book never walk the ladder
+    size_t depth(Side side, size_t n, std::span<TopOfBook> out) const;
+
+    // order-node slab usage (live slots, allocated slots, high-water mark)
+    PoolStats pool_stats() const;
+
+    // bytes held by levels, order nodes (= the id index) and the price ladders, see MemoryUsage
+    MemoryUsage memory_usage() const;
+
+    // engine counters. with MINIEX_STATS on, this only reads relaxed atomics, so a monitoring
+    // thread may call it while another thread is matching (values may be a few ops stale).
+    // with it off, only the gauges are filled, read straight from the book - owning thread only
+    BookStats stats() const;
+
 private:
     // Intentionally opaque: no internals leak into the header.
-    // (We’ll define data structures in OrderBook.cpp.)
+    // pimpl - Impl is only declared here and defined in OrderBook.cpp,
+    // so data structures can change without recompiling callers
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
 };
 
 //
\ No newline at end of file
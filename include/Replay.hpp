@@ -0,0 +1,38 @@
+// multi-symbol replay for backtests / end-of-day reconciliation
+// books never interact, so a day of flow splits into one independent job per symbol: the jobs
+// run on a small work-stealing thread pool and their trades are merged back into one stream
+// whose order does not depend on the thread count (threads = 1 is the serial reference)
+
+#pragma once
+
+#include "BookManager.hpp"
+#include "OrderBook.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct ReplayOptions {
+    unsigned    threads     = 0;     // worker threads; 0 = one per core. 1 = replay inline on the caller
+    bool        add_symbols = true;  // create books for symbols the manager does not have yet
+    BookOptions book_options;        // used for books created by add_symbols
+};
+
+// one fill in the merged output
+struct ReplayTrade {
+    uint64_t event;      // index of the command (in the input span) that caused it
+    uint32_t symbol_id;
+    Trade    trade;
+};
+
+struct ReplayResult {
+    // one per input event, in input order. first_trade is unused (0): a command's trades are
+    // the ReplayTrades with its event index. unknown symbol (add_symbols off) -> ok = false
+    std::vector<CommandAck>  acks;
+    // every fill, ordered by (trade.ts, event, match order within the event). the same input
+    // gives exactly the same vector for any thread count
+    std::vector<ReplayTrade> trades;
+};
+
+// apply events to books (each symbol's commands in input order) and collect the results.
+// books are touched only by the replay until it returns
+ReplayResult replay(std::span<const SymbolCommand> events, BookManager& books, const ReplayOptions& opts = {});
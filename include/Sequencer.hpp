@@ -0,0 +1,85 @@
+// sequencer mode: one matching thread owns every book, gateway threads talk to it through rings
+// OrderBook / BookManager are single-threaded on purpose (no locks in the matcher). instead of
+// making the network threads share a mutex around them, each gateway thread gets its own
+// Producer: commands go in through a lock-free SPSC ring, acks + trades come back through another
+
+#pragma once
+
+#include "BookManager.hpp"
+#include "OrderBook.hpp"
+#include "SpscRing.hpp"
+#include <atomic>    // run flag, sequence counter
+#include <cstddef>   // size_t
+#include <cstdint>   // fixed-width ints
+#include <memory>    // producers live at fixed addresses
+#include <thread>    // the matching thread
+#include <vector>
+
+enum class ReportType : uint8_t { Trade, Ack };
+
+// one outbound event. a command's trades are reported before its ack, so by the time a
+// producer sees the ack it has every fill of that command
+struct Report {
+    uint64_t   seq;        // global sequence number of the command (1, 2, 3 ... across all producers)
+    uint32_t   symbol_id;
+    ReportType type;
+    union {
+        Trade      trade;  // type == Trade
+        CommandAck ack;    // type == Ack. first_trade is unused (0); unknown symbol -> ok = false, order_id = 0
+    };
+};
+
+struct SequencerOptions {
+    size_t   command_ring = 1 << 16; // per producer, rounded up to a power of two
+    size_t   report_ring  = 1 << 16; // per producer, rounded up to a power of two
+    int      cpu          = -1;      // pin the matching thread to this cpu (Linux); -1 = let the OS place it
+    uint32_t burst        = 64;      // commands taken from one producer before moving to the next (fairness)
+};
+
+class Sequencer {
+public:
+    // handle for one gateway thread. submit() / poll() must only ever be called from that thread
+    class Producer {
+    public:
+        // false if the command ring is full (back off and retry)
+        bool submit(uint32_t symbol_id, const Command& cmd) { return in_.try_push(SymbolCommand{ symbol_id, cmd }); }
+        // next report for this producer's commands, in submission order; false if none yet
+        bool poll(Report& out) { return out_.try_pop(out); }
+
+    private:
+        friend class Sequencer;
+        Producer(size_t command_ring, size_t report_ring) : in_(command_ring), out_(report_ring) {}
+        SpscRing<SymbolCommand> in_;
+        SpscRing<Report>        out_;
+    };
+
+    // books is not owned. between start() and stop() only the matching thread may touch it
+    explicit Sequencer(BookManager& books, const SequencerOptions& opts = {});
+    ~Sequencer(); // stops the thread if still running
+    Sequencer(const Sequencer&)            = delete;
+    Sequencer& operator=(const Sequencer&) = delete;
+
+    // register a gateway thread. only before start(); the reference stays valid for the sequencer's life
+    Producer& add_producer();
+
+    // launch the matching thread. false if already running
+    bool start();
+    // finish every command already submitted, then join the thread. producers should stop
+    // submitting first - anything pushed after the final drain is left in the ring
+    void stop();
+
+    // commands sequenced so far (safe to read from any thread)
+    uint64_t sequenced() const { return seq_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void process(Producer& p, const SymbolCommand& sc);
+    void emit(Producer& p, const Report& r);
+
+    BookManager&                           books_;
+    SequencerOptions                       opts_;
+    std::vector<std::unique_ptr<Producer>> producers_;
+    std::thread                            thread_;
+    std::atomic<bool>                      running_{false};
+    std::atomic<uint64_t>                  seq_{0}; // written by the matching thread only
+};
@@ -0,0 +1,72 @@
+// bounded lock-free queue between exactly one producer thread and one consumer thread
+// used by the Sequencer for gateway -> matcher commands and matcher -> gateway reports
+
+#pragma once
+
+#include <atomic>       // head / tail indices
+#include <cstddef>      // size_t
+#include <memory>       // std::unique_ptr for the slot array
+#include <type_traits>  // trivially copyable payloads only
+
+/*
+ * Classic single-producer / single-consumer ring:
+ *   - head_ is only written by the consumer, tail_ only by the producer, so neither side
+ *     needs a CAS or a locked instruction - one release store per push / pop
+ *   - indices grow forever (size_t wraps long after the heat death of the box) and are
+ *     masked into a power-of-two slot array
+ *   - each side keeps a private copy of the other side's index and only re-reads the shared
+ *     one when the copy says full / empty, so in steady state a push or pop touches no
+ *     cache line the other thread is writing
+ */
+template <class T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "slots are copied with plain assignment");
+
+public:
+    // capacity is rounded up to a power of two (minimum 2)
+    explicit SpscRing(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        slots_ = std::make_unique<T[]>(cap);
+    }
+    SpscRing(const SpscRing&)            = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // producer thread only. false if the ring is full (nothing written)
+    bool try_push(const T& v) {
+        const size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (t - head_cache_ > mask_) return false;
+        }
+        slots_[t & mask_] = v;
+        tail_.store(t + 1, std::memory_order_release); // publishes the slot
+        return true;
+    }
+
+    // consumer thread only. false if the ring is empty
+    bool try_pop(T& out) {
+        const size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (h == tail_cache_) return false;
+        }
+        out = slots_[h & mask_];
+        head_.store(h + 1, std::memory_order_release); // hands the slot back to the producer
+        return true;
+    }
+
+    // either thread; a racy hint, exact only when both sides are quiet
+    bool   empty() const    { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    // 64 = cache line on every target we care about; keeps the two sides from false sharing
+    alignas(64) std::atomic<size_t> head_{0}; // next slot to pop   (written by the consumer)
+    size_t                          tail_cache_ = 0; // consumer's last look at tail_
+    alignas(64) std::atomic<size_t> tail_{0}; // next slot to push  (written by the producer)
+    size_t                          head_cache_ = 0; // producer's last look at head_
+    alignas(64) size_t              mask_;
+    std::unique_ptr<T[]>            slots_;
+};
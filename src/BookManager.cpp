@@ -0,0 +1,32 @@
+// symbol routing for many books per process
+#include "BookManager.hpp"
+
+BookManager::BookManager(size_t expected_symbols) {
+    symbol_of_.reserve(expected_symbols);
+    slot_of_.reserve(expected_symbols);
+}
+
+OrderBook& BookManager::add_symbol(uint32_t symbol_id, const BookOptions& opts) {
+    // already registered -> hand back the same book (idempotent)
+    if (OrderBook* existing = find(symbol_id)) return *existing;
+
+    // grow the routing table to cover this id; new entries start as "no book"
+    if (symbol_id >= slot_of_.size()) slot_of_.resize(size_t{symbol_id} + 1, kNoSlot);
+
+    slot_of_[symbol_id] = static_cast<uint32_t>(books_.size());
+    symbol_of_.push_back(symbol_id);
+    books_.emplace_back(opts);   // fresh, empty book with its own state
+    return books_.back();
+}
+
+OrderBook* BookManager::find(uint32_t symbol_id) {
+    if (symbol_id >= slot_of_.size()) return nullptr;
+    const uint32_t slot = slot_of_[symbol_id];
+    return slot == kNoSlot ? nullptr : &books_[slot];
+}
+
+const OrderBook* BookManager::find(uint32_t symbol_id) const {
+    if (symbol_id >= slot_of_.size()) return nullptr;
+    const uint32_t slot = slot_of_[symbol_id];
+    return slot == kNoSlot ? nullptr : &books_[slot];
+}
@@ -0,0 +1,639 @@
+// internal data structures behind OrderBook (not part of the public api - lives in src/, not include/)
+// split out of OrderBook.cpp so the matching code there reads top to bottom without
+// scrolling past the containers it runs on
+#pragma once
+
+#include "OrderBook.hpp"
+#include <algorithm>   // std::fill
+#include <bit>         // std::countr_zero / std::countl_zero (find-first-set)
+#include <cstdint>
+#include <deque>       // stable addresses for the level slab
+#include <iterator>    // std::make_reverse_iterator
+#include <limits>      // window clamp at the ends of the price range
+#include <map>         // ordered price -> level index
+#include <span>        // depth() output
+#include <vector>
+
+namespace detail {
+
+    /// "no index" marker for level indices / empty ladder slots
+    inline constexpr uint32_t kNil = UINT32_MAX;
+
+    /**
+     * @brief Everything the matcher needs to know about a side, resolved at compile time.
+     *
+     * The matching kernel is instantiated once per (taker side, order kind), so the
+     * "which ladder / which end is best / which way does the limit compare" questions
+     * become constants instead of branches inside the fill loop.
+     */
+    template <Side S> struct SideTraits;
+    template <> struct SideTraits<Side::Buy> {
+        static constexpr Side opposite = Side::Sell;
+        /// a is a better price than b on this side (bids: higher)
+        static constexpr bool better(int64_t a, int64_t b) { return a > b; }
+        /// a buy limited at `limit` trades against a resting ask at `book_px`
+        static constexpr bool crosses(int64_t book_px, int64_t limit) { return book_px <= limit; }
+    };
+    template <> struct SideTraits<Side::Sell> {
+        static constexpr Side opposite = Side::Buy;
+        /// a is a better price than b on this side (asks: lower)
+        static constexpr bool better(int64_t a, int64_t b) { return a < b; }
+        /// a sell limited at `limit` trades against a resting bid at `book_px`
+        static constexpr bool crosses(int64_t book_px, int64_t limit) { return book_px >= limit; }
+    };
+
+    /// what the matching kernel is specialized on besides the side
+    enum class OrderKind { Limit, Market };
+
+    /**
+     * @brief A single resting order node within a price level's FIFO queue.
+     *
+     * Nodes live in the book's @c OrderPool and link to their neighbours by 32-bit slot
+     * index (intrusive doubly linked list), so the queue needs no per-order heap node and
+     * walking it stays inside one contiguous array. The order id is not stored: it is
+     * (gen << 32) | slot, see @c OrderPool::id_of.
+     */
+    struct OrderNode {
+        int64_t  remaining_qty; ///< Unfilled quantity for this node
+        uint64_t ts;            ///< Submission timestamp (earlier = higher FIFO priority)
+        uint32_t prev = kNil;   ///< Older neighbour in the level queue (kNil = head)
+        uint32_t next = kNil;   ///< Newer neighbour in the level queue (kNil = tail); free-list link while unused
+        uint32_t level = kNil;  ///< Index of the owning Level in the LevelSlab (kNil = not resting)
+        uint32_t gen   = 1;     ///< Bumped every time the slot is recycled; never 0, so ids are never 0
+        Side     side  = Side::Buy; ///< Side the order rests on
+    };
+
+    /**
+     * @brief One price level on one side of the book.
+     *
+     * Maintains:
+     *  - @c px_ticks      : the price this level sits at (so a level index alone is enough to print trades).
+     *  - @c aggregate_qty : sum of all node quantities at this price.
+     *  - @c head / @c tail : FIFO of resting orders at this price (slot indices into the OrderPool),
+     *                        oldest at head.
+     *
+     * @note Intrusive prev/next indices give O(1) push-back, pop-front and erase-anywhere,
+     *       the same properties std::list gave us, without an allocation per order.
+     * @note A queued node with @c remaining_qty == 0 is a lazy-cancel tombstone: its id is
+     *       already retired and its qty is already out of @c aggregate_qty.
+     */
+    struct Level {
+        int64_t  px_ticks = 0;      ///< Price of this level (in ticks)
+        int64_t  aggregate_qty = 0; ///< Sum of remaining_qty for all nodes at this price
+        uint32_t head = kNil;       ///< Oldest order (first to fill)
+        uint32_t tail = kNil;       ///< Newest order (append here)
+        uint32_t count = 0;         ///< Orders queued at this level
+        uint32_t l2_slot = kNil;    ///< This command's entry in the L2 update batch (kNil = not touched yet)
+        uint32_t dead = 0;          ///< Lazy-cancel tombstones still queued here (counted in @c count)
+    };
+
+    /**
+     * @brief Slab of OrderNodes owned by one book, recycled through an intrusive free list.
+     *
+     * Filled / cancelled slots go back on the free list and are handed out again LIFO
+     * (the most recently freed slot is the one most likely still in cache). The slab only
+     * grows when live orders exceed every previous peak, so once it is sized (see
+     * @c BookOptions::order_capacity) steady-state add/cancel/match never allocates.
+     *
+     * The pool is also the order-id index: an id encodes (generation << 32) | slot, so
+     * finding an order is one array access, and the generation check rejects ids whose
+     * slot has since been recycled (filled, cancelled, or never rested).
+     */
+    class OrderPool {
+    public:
+        /// make sure at least n slots exist (extra slots go on the free list)
+        void reserve(size_t n) {
+            if (n <= nodes_.size()) return;
+            const uint32_t old = static_cast<uint32_t>(nodes_.size());
+            nodes_.resize(n);
+            // thread new slots so they pop in ascending order: old, old+1, ...
+            for (uint32_t i = static_cast<uint32_t>(n); i-- > old;) {
+                nodes_[i].gen  = gen_floor_;
+                nodes_[i].next = free_head_;
+                free_head_ = i;
+            }
+        }
+
+        uint32_t acquire() {
+            if (free_head_ == kNil) reserve(nodes_.empty() ? 64 : nodes_.size() * 2);
+            const uint32_t i = free_head_;
+            free_head_ = nodes_[i].next;
+            nodes_[i].prev = nodes_[i].next = kNil;
+            if (++live_ > high_water_) high_water_ = live_;
+            return i;
+        }
+
+        void release(uint32_t i) {
+            nodes_[i].level = kNil;
+            // invalidate every id handed out for this slot so far (skip 0: id 0 means "rejected")
+            if (++nodes_[i].gen == 0) nodes_[i].gen = 1;
+            nodes_[i].next  = free_head_;
+            free_head_ = i;
+            --live_;
+        }
+
+        /// retire every id handed out for slot i while the node stays linked (lazy-cancel tombstone);
+        /// the slot goes back on the free list only when release() unlinks it for good
+        void retire(uint32_t i) {
+            if (++nodes_[i].gen == 0) nodes_[i].gen = 1;
+        }
+
+        /// engine order id for the order currently in slot i
+        uint64_t id_of(uint32_t i) const { return (uint64_t{nodes_[i].gen} << 32) | i; }
+
+        /// slot of a resting order, kNil if the id is unknown, stale, or never rested. a tombstone
+        /// is still queued under its retired generation, which was never handed out: qty 0 rejects it
+        uint32_t locate(uint64_t id) const {
+            const uint64_t slot = id & 0xFFFFFFFFu;
+            if (slot >= nodes_.size()) return kNil;
+            const OrderNode& n = nodes_[slot];
+            if (n.gen != static_cast<uint32_t>(id >> 32) || n.level == kNil || n.remaining_qty == 0) return kNil;
+            return static_cast<uint32_t>(slot);
+        }
+
+        /// start pulling the node for `id` into cache ahead of a cancel (no-op on stale / unknown ids)
+        void prefetch(uint64_t id) const {
+#if defined(__GNUC__) || defined(__clang__)
+            const uint64_t slot = id & 0xFFFFFFFFu;
+            if (slot < nodes_.size()) __builtin_prefetch(&nodes_[slot]);
+#else
+            (void)id;
+#endif
+        }
+
+        /// append node i at the tail of the level's FIFO
+        void push_back(Level& level, uint32_t level_idx, uint32_t i) {
+            OrderNode& n = nodes_[i];
+            n.level = level_idx;
+            n.prev  = level.tail;
+            n.next  = kNil;
+            if (level.tail != kNil) nodes_[level.tail].next = i; else level.head = i;
+            level.tail = i;
+            ++level.count;
+        }
+
+        /// unlink node i from anywhere in the level's FIFO (O(1))
+        void unlink(Level& level, uint32_t i) {
+            OrderNode& n = nodes_[i];
+            if (n.prev != kNil) nodes_[n.prev].next = n.next; else level.head = n.next;
+            if (n.next != kNil) nodes_[n.next].prev = n.prev; else level.tail = n.prev;
+            --level.count;
+        }
+
+        OrderNode&       operator[](uint32_t i)       { return nodes_[i]; }
+        const OrderNode& operator[](uint32_t i) const { return nodes_[i]; }
+
+        PoolStats stats() const { return PoolStats{ live_, nodes_.size(), high_water_ }; }
+        size_t bytes() const    { return nodes_.capacity() * sizeof(OrderNode); }
+
+        /// free slots at the end of the table, past the last one in use (never counting below `keep`)
+        size_t trimmable(size_t keep) const {
+            size_t n = nodes_.size();
+            while (n > keep && nodes_[n - 1].level == kNil) --n;
+            return nodes_.size() - n;
+        }
+
+        /// drop what trimmable(keep) counts and give the memory back. the free list keeps its
+        /// order, and slots created again later start above every generation the dropped ones
+        /// reached, so ids handed out for them never resolve again
+        size_t trim(size_t keep) {
+            const size_t cut = trimmable(keep);
+            if (cut == 0) return 0;
+            const size_t n = nodes_.size() - cut;
+            for (size_t i = n; i < nodes_.size(); ++i)
+                if (nodes_[i].gen >= gen_floor_) gen_floor_ = nodes_[i].gen + 1 == 0 ? 1 : nodes_[i].gen + 1;
+            uint32_t* link = &free_head_;
+            for (uint32_t i = free_head_; i != kNil;) {
+                const uint32_t next = nodes_[i].next;
+                if (i < n) { *link = i; link = &nodes_[i].next; }
+                i = next;
+            }
+            *link = kNil;
+            nodes_.resize(n);
+            nodes_.shrink_to_fit();
+            return cut;
+        }
+
+        // --- snapshot support: the slot table (generations + free-list order) is part of the
+        //     book's state, because it decides which ids future orders get ---
+        size_t   size() const            { return nodes_.size(); }
+        uint32_t gen(uint32_t i) const   { return nodes_[i].gen; }
+        uint32_t gen_floor() const       { return gen_floor_; }
+        /// free slots in the order acquire() would hand them out
+        template <class F>
+        void for_each_free(F&& f) const {
+            for (uint32_t i = free_head_; i != kNil; i = nodes_[i].next) f(i);
+        }
+        /// reset to a saved slot table: every slot not on `free_order` is live (the caller
+        /// links those into levels afterwards)
+        void restore(const uint32_t* gens, size_t n_slots, const uint32_t* free_order, size_t n_free, uint32_t gen_floor) {
+            gen_floor_ = gen_floor;
+            nodes_.assign(n_slots, OrderNode{});
+            for (size_t i = 0; i < n_slots; ++i) nodes_[i].gen = gens[i];
+            free_head_ = kNil;
+            for (size_t k = n_free; k-- > 0;) {
+                nodes_[free_order[k]].next = free_head_;
+                free_head_ = free_order[k];
+            }
+            live_ = high_water_ = n_slots - n_free;
+        }
+
+    private:
+        std::vector<OrderNode> nodes_;              ///< every slot, live or free
+        uint32_t               free_head_ = kNil;   ///< top of the free-slot stack
+        size_t                 live_ = 0;           ///< slots currently handed out
+        size_t                 high_water_ = 0;     ///< max live_ ever seen
+        uint32_t               gen_floor_ = 1;      ///< generation new slots start at (raised by trim())
+    };
+
+    /**
+     * @brief Owns every Level of a book; levels are addressed by a 32-bit index.
+     *
+     * The price ladders (map or dense array) only store indices into this slab, so a
+     * level never moves when a ladder rebalances or re-centers, and an OrderNode can keep
+     * pointing at it. Released indices are recycled through a free list.
+     *
+     * @note @c std::deque keeps element addresses stable across @c emplace_back.
+     */
+    class LevelSlab {
+    public:
+        uint32_t acquire(int64_t px_ticks) {
+            uint32_t idx;
+            if (!free_.empty()) { idx = free_.back(); free_.pop_back(); }
+            else { idx = static_cast<uint32_t>(levels_.size()); levels_.emplace_back(); }
+            levels_[idx].px_ticks = px_ticks;
+            return idx;
+        }
+        // caller guarantees the level is empty (no queued orders)
+        void release(uint32_t idx) {
+            levels_[idx].aggregate_qty = 0;
+            levels_[idx].head = levels_[idx].tail = kNil;
+            levels_[idx].l2_slot = kNil;
+            levels_[idx].dead = 0;
+            free_.push_back(idx);
+        }
+        Level&       operator[](uint32_t idx)       { return levels_[idx]; }
+        const Level& operator[](uint32_t idx) const { return levels_[idx]; }
+
+        size_t bytes() const { return levels_.size() * sizeof(Level) + free_.capacity() * sizeof(uint32_t); }
+
+        /// drop the released levels at the end of the slab (indices past the last live one)
+        void trim() {
+            size_t n = levels_.size();
+            std::vector<bool> is_free(n, false);
+            for (uint32_t idx : free_) is_free[idx] = true;
+            while (n > 0 && is_free[n - 1]) --n;
+            std::erase_if(free_, [n](uint32_t idx) { return idx >= n; });
+            levels_.resize(n);
+            levels_.shrink_to_fit();
+            free_.shrink_to_fit();
+        }
+
+    private:
+        std::deque<Level>     levels_; ///< every level ever created (live or on the free list)
+        std::vector<uint32_t> free_;   ///< released indices, reused LIFO
+    };
+
+    /**
+     * @brief Price ladder on a red-black tree: price -> level index.
+     *
+     * @complexity find/insert/erase O(log L); best() O(1) via map extremes
+     *             (bids: highest key = std::prev(end()), asks: lowest key = begin()).
+     *
+     * Erased tree nodes are kept (extracted node handles) and re-keyed by the next insert, so
+     * a touch that keeps emptying and re-creating levels does not go through the allocator.
+     */
+    class MapLadder {
+    public:
+        MapLadder(Side side, const BookOptions&) : side_(side) {}
+
+        uint32_t find(int64_t px) const {
+            auto it = m_.find(px);
+            return it == m_.end() ? kNil : it->second;
+        }
+        void insert(int64_t px, uint32_t idx) {
+            if (spare_.empty()) { m_.emplace(px, idx); return; }
+            auto node = std::move(spare_.back());
+            spare_.pop_back();
+            node.key()    = px;
+            node.mapped() = idx;
+            m_.insert(std::move(node));
+        }
+        void erase(int64_t px) {
+            if (auto node = m_.extract(px)) spare_.push_back(std::move(node));
+        }
+        void clear() {
+            while (!m_.empty()) spare_.push_back(m_.extract(m_.begin()));
+        }
+        bool empty() const                    { return m_.empty(); }
+        size_t size() const                   { return m_.size(); }
+
+        /// tree nodes (live + spare) and the spare list. node size is the usual red-black
+        /// layout (colour + 3 links + value), an estimate: the allocator's own overhead is not seen
+        size_t bytes() const {
+            constexpr size_t kNode = 4 * sizeof(void*) + sizeof(std::pair<const int64_t, uint32_t>);
+            return (m_.size() + spare_.size()) * kNode + spare_.capacity() * sizeof(Node);
+        }
+        /// free the spare nodes
+        void shrink() {
+            spare_.clear();
+            spare_.shrink_to_fit();
+        }
+
+        /// level index of the best price on this side, kNil if the side is empty
+        uint32_t best() const { return side_ == Side::Buy ? best<Side::Buy>() : best<Side::Sell>(); }
+
+        /// best() for a ladder known to hold side S (the matcher's branch-free accessor)
+        template <Side S>
+        uint32_t best() const {
+            if (m_.empty()) return kNil;
+            if constexpr (S == Side::Buy) return std::prev(m_.end())->second;
+            else                          return m_.begin()->second;
+        }
+
+        /// visit level indices best price first; stop early when f returns false
+        template <class F>
+        void for_each(F&& f) const {
+            if (side_ == Side::Buy) { for (auto it = m_.rbegin(); it != m_.rend(); ++it) if (!f(it->second)) return; }
+            else                    { for (auto it = m_.begin();  it != m_.end();  ++it) if (!f(it->second)) return; }
+        }
+
+    private:
+        using Node = std::map<int64_t, uint32_t>::node_type;
+
+        Side                         side_;
+        std::map<int64_t, uint32_t>  m_;     ///< price -> index into the LevelSlab
+        std::vector<Node>            spare_; ///< erased tree nodes, reused LIFO by insert()
+    };
+
+    /**
+     * @brief Dense, tick-indexed price ladder with a two-level occupancy bitmap.
+     *
+     * Prices inside the window [base_, base_ + width_) live in a flat array indexed by
+     * @c px - base_; one bit per tick says "a level exists here", and one summary bit per
+     * 64-tick word says "this word has any bit set". Best price / next level is then two
+     * find-first-set (asks) or find-last-set (bids) instructions instead of a tree walk.
+     *
+     * Prices outside the window go to a small sparse map (@c far_). The window re-centers
+     * on the new price when it is empty, or when an insert lands beyond its best edge
+     * (the touch drifted out of it), so the active band around the touch stays dense.
+     * The window is clamped to the int64 range, so no offset arithmetic can overflow.
+     *
+     * @complexity find/insert/erase O(1) inside the window, O(log F) for far prices;
+     *             best() O(width / 4096) word scans (a single word for the default width).
+     */
+    class DenseLadder {
+    public:
+        DenseLadder(Side side, const BookOptions& opts)
+            : side_(side),
+              // round the window up to whole 64-tick words
+              width_(std::max<uint32_t>(64, (opts.dense_window_ticks + 63) / 64 * 64)),
+              slot_(width_, kNil),
+              l1_(width_ / 64, 0),
+              l2_((width_ / 64 + 63) / 64, 0) {}
+
+        uint32_t find(int64_t px) const {
+            if (in_window(px)) return slot_[px - base_];
+            auto it = far_.find(px);
+            return it == far_.end() ? kNil : it->second;
+        }
+
+        void insert(int64_t px, uint32_t idx) {
+            // nothing dense yet, or the new price is better than everything in the window
+            // (the touch walked off the edge): move the window onto the new price
+            if (!in_window(px) && (window_count_ == 0 || beyond_best_edge(px))) recenter(px);
+            if (in_window(px)) set(static_cast<size_t>(px - base_), idx);
+            else               far_.emplace(px, idx);
+        }
+
+        void erase(int64_t px) {
+            if (!in_window(px)) { far_.erase(px); return; }
+            clear(static_cast<size_t>(px - base_));
+            // window drained but far levels remain: pull the window over the best of them
+            if (window_count_ == 0 && !far_.empty())
+                recenter(side_ == Side::Buy ? std::prev(far_.end())->first : far_.begin()->first);
+        }
+
+        /// drop every level at once (mass cancel of a whole side); the window stays where it is
+        void clear() {
+            std::fill(slot_.begin(), slot_.end(), kNil);
+            std::fill(l1_.begin(), l1_.end(), 0);
+            std::fill(l2_.begin(), l2_.end(), 0);
+            window_count_ = 0;
+            far_.clear();
+        }
+
+        bool empty() const { return window_count_ == 0 && far_.empty(); }
+        size_t size() const { return window_count_ + far_.size(); }
+
+        /// window arrays + far map nodes (estimated like MapLadder's)
+        size_t bytes() const {
+            constexpr size_t kNode = 4 * sizeof(void*) + sizeof(std::pair<const int64_t, uint32_t>);
+            return slot_.capacity() * sizeof(uint32_t) + (l1_.capacity() + l2_.capacity()) * sizeof(uint64_t)
+                 + far_.size() * kNode;
+        }
+        /// nothing pooled: the window is fixed-size and far levels are rare enough to allocate
+        void shrink() {}
+
+        /// level index of the best price on this side, kNil if the side is empty
+        uint32_t best() const { return side_ == Side::Buy ? best<Side::Buy>() : best<Side::Sell>(); }
+
+        /// best() for a ladder known to hold side S (the matcher's branch-free accessor)
+        template <Side S>
+        uint32_t best() const {
+            const size_t w = S == Side::Buy ? window_last() : window_first();
+            if (far_.empty()) return w == kNpos ? kNil : slot_[w];
+            // far prices can sit on either side of the window; compare against the best of them
+            const auto far_best = S == Side::Buy ? std::prev(far_.end()) : far_.begin();
+            if (w == kNpos) return far_best->second;
+            const int64_t wpx = base_ + static_cast<int64_t>(w);
+            return SideTraits<S>::better(far_best->first, wpx) ? far_best->second : slot_[w];
+        }
+
+        /// visit level indices best price first; stop early when f returns false.
+        /// order: far levels beyond the window's best edge, the window (bitmap scan), far levels behind it
+        template <class F>
+        void for_each(F&& f) const {
+            const int64_t top = base_ + static_cast<int64_t>(width_);
+            if (side_ == Side::Buy) {
+                for (auto it = far_.rbegin(); it != far_.rend() && it->first >= top; ++it) if (!f(it->second)) return;
+                for (size_t s = l2_.size(); s-- > 0;) {
+                    uint64_t words = l2_[s];
+                    while (words) {
+                        const size_t wb = 63 - std::countl_zero(words);
+                        words &= ~(uint64_t{1} << wb);
+                        const size_t w = s * 64 + wb;
+                        uint64_t bits = l1_[w];
+                        while (bits) {
+                            const size_t b = 63 - std::countl_zero(bits);
+                            bits &= ~(uint64_t{1} << b);
+                            if (!f(slot_[w * 64 + b])) return;
+                        }
+                    }
+                }
+                for (auto it = std::make_reverse_iterator(far_.lower_bound(base_)); it != far_.rend(); ++it)
+                    if (!f(it->second)) return;
+            } else {
+                for (auto it = far_.begin(); it != far_.end() && it->first < base_; ++it) if (!f(it->second)) return;
+                for (size_t s = 0; s < l2_.size(); ++s) {
+                    uint64_t words = l2_[s];
+                    while (words) {
+                        const size_t w = s * 64 + std::countr_zero(words);
+                        words &= words - 1;
+                        uint64_t bits = l1_[w];
+                        while (bits) {
+                            const size_t i = w * 64 + std::countr_zero(bits);
+                            bits &= bits - 1;
+                            if (!f(slot_[i])) return;
+                        }
+                    }
+                }
+                for (auto it = far_.lower_bound(top); it != far_.end(); ++it) if (!f(it->second)) return;
+            }
+        }
+
+    private:
+        static constexpr size_t kNpos = SIZE_MAX;
+
+        bool in_window(int64_t px) const { return px >= base_ && px < base_ + static_cast<int64_t>(width_); }
+        bool beyond_best_edge(int64_t px) const {
+            return side_ == Side::Buy ? px >= base_ + static_cast<int64_t>(width_) : px < base_;
+        }
+
+        void set(size_t i, uint32_t idx) {
+            slot_[i] = idx;
+            l1_[i / 64]    |= uint64_t{1} << (i % 64);
+            l2_[i / 4096]  |= uint64_t{1} << ((i / 64) % 64);
+            ++window_count_;
+        }
+        void clear(size_t i) {
+            slot_[i] = kNil;
+            l1_[i / 64] &= ~(uint64_t{1} << (i % 64));
+            if (l1_[i / 64] == 0) l2_[i / 4096] &= ~(uint64_t{1} << ((i / 64) % 64));
+            --window_count_;
+        }
+
+        // lowest occupied tick offset in the window (kNpos if none)
+        size_t window_first() const {
+            for (size_t s = 0; s < l2_.size(); ++s) {
+                if (!l2_[s]) continue;
+                const size_t w = s * 64 + std::countr_zero(l2_[s]);
+                return w * 64 + std::countr_zero(l1_[w]);
+            }
+            return kNpos;
+        }
+        // highest occupied tick offset in the window (kNpos if none)
+        size_t window_last() const {
+            for (size_t s = l2_.size(); s-- > 0;) {
+                if (!l2_[s]) continue;
+                const size_t w = s * 64 + 63 - std::countl_zero(l2_[s]);
+                return w * 64 + 63 - std::countl_zero(l1_[w]);
+            }
+            return kNpos;
+        }
+
+        // move the window so it is centered on `center`: spill the old window into far_,
+        // then pull every far level that fits the new range back into the array
+        void recenter(int64_t center) {
+            for (size_t s = 0; s < l2_.size(); ++s) {
+                uint64_t words = l2_[s];
+                while (words) {
+                    const size_t w = s * 64 + std::countr_zero(words);
+                    words &= words - 1;
+                    uint64_t bits = l1_[w];
+                    while (bits) {
+                        const size_t i = w * 64 + std::countr_zero(bits);
+                        bits &= bits - 1;
+                        far_.emplace(base_ + static_cast<int64_t>(i), slot_[i]);
+                        slot_[i] = kNil;
+                    }
+                    l1_[w] = 0;
+                }
+            }
+            std::fill(l2_.begin(), l2_.end(), 0);
+            window_count_ = 0;
+
+            // clamped so base_ + width_ (and every tick offset) stays inside int64 at the ends
+            // of the price range; a price at INT64_MAX itself then lives in far_
+            constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+            const int64_t half = static_cast<int64_t>(width_ / 2);
+            const int64_t top  = std::numeric_limits<int64_t>::max() - static_cast<int64_t>(width_);
+            base_ = center < kMin + half ? kMin : std::min(center - half, top);
+            auto lo = far_.lower_bound(base_);
+            auto hi = far_.lower_bound(base_ + static_cast<int64_t>(width_));
+            for (auto it = lo; it != hi; ++it) set(static_cast<size_t>(it->first - base_), it->second);
+            far_.erase(lo, hi);
+        }
+
+        Side                        side_;
+        uint32_t                    width_;            ///< ticks covered by the dense window (multiple of 64)
+        int64_t                     base_ = 0;         ///< price of slot_[0]
+        size_t                      window_count_ = 0; ///< levels currently inside the window
+        std::vector<uint32_t>       slot_;             ///< tick offset -> level index (kNil = no level)
+        std::vector<uint64_t>       l1_;               ///< bit per tick: level present
+        std::vector<uint64_t>       l2_;               ///< bit per l1_ word: word non-zero
+        std::map<int64_t, uint32_t> far_;              ///< sparse fallback for prices outside the window
+    };
+
+    /**
+     * @brief Contiguous copy of the best levels of one side, for depth(n) readers.
+     *
+     * Built on demand by walking the ladder best-first, then kept up to date from the
+     * matcher's level-change hook:
+     *  - a level already in the copy changes size -> patched in place
+     *  - a level appears / disappears inside the copied range -> dropped, rebuilt lazily on
+     *    the next read (positions shift, and a disappearing level pulls a new one in)
+     *  - anything worse than the last copied level -> ignored, it cannot affect the top N
+     * So a reader only walks the ladder after the top of the book reshaped, never per read.
+     */
+    class DepthCache {
+    public:
+        // the level at px on `side` now holds agg_qty (0 = gone)
+        void on_change(Side side, int64_t px_ticks, int64_t agg_qty) {
+            if (!valid_) return;
+            const auto better_or_eq = [side](int64_t a, int64_t b) { return side == Side::Buy ? a >= b : a <= b; };
+            // worse than everything we hold, and we do not hold the whole side: not our business
+            if (!complete_ && !better_or_eq(px_ticks, levels_.back().px_ticks)) return;
+            for (TopOfBook& l : levels_) {
+                if (l.px_ticks == px_ticks) {
+                    if (agg_qty == 0) break; // removed: the rest shifts up
+                    l.agg_qty = agg_qty;
+                    return;
+                }
+                if (!better_or_eq(l.px_ticks, px_ticks)) break; // new level slots in here
+            }
+            valid_ = false;
+        }
+
+        // copy the best min(n, out.size()) levels into out; rebuilds from the ladder if needed
+        template <class Ladder, class Slab>
+        size_t read(const Ladder& lad, const Slab& slab, size_t n, std::span<TopOfBook> out) {
+            n = std::min(n, out.size());
+            if (!valid_ || (!complete_ && levels_.size() < n)) {
+                // cache at least what was asked for; readers tend to ask for the same n every time
+                want_ = std::max(want_, n);
+                levels_.clear();
+                lad.for_each([&](uint32_t idx) {
+                    if (levels_.size() == want_) return false;
+                    levels_.push_back(TopOfBook{ slab[idx].px_ticks, slab[idx].aggregate_qty });
+                    return true;
+                });
+                complete_ = levels_.size() < want_;
+                valid_    = !levels_.empty() || complete_;
+            }
+            const size_t k = std::min(n, levels_.size());
+            std::copy_n(levels_.begin(), k, out.begin());
+            return k;
+        }
+
+        void reset() { valid_ = false; }
+        size_t bytes() const { return levels_.capacity() * sizeof(TopOfBook); }
+
+    private:
+        std::vector<TopOfBook> levels_;          ///< best first
+        size_t                 want_     = 0;    ///< how many levels a rebuild copies
+        bool                   valid_    = false;
+        bool                   complete_ = false; ///< levels_ is the entire side (fewer than want_ levels exist)
+    };
+
+} // namespace detail
@@ -0,0 +1,129 @@
+// journal file I/O (POSIX: open/write/fsync/mmap)
+#include "Journal.hpp"
+#include <algorithm>    // std::max / std::min
+#include "MappedFile.hpp"
+#include <fcntl.h>      // open
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // write, fsync, close
+
+namespace {
+
+    constexpr char kMagic[8] = { 'M', 'N', 'X', 'J', 'R', 'N', 'L', '\0' };
+
+    bool header_ok(const JournalHeader& h) {
+        return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0
+            && h.version == Journal::kVersion
+            && h.record_size == sizeof(Command);
+    }
+
+    // write [p, p + n), retrying short writes; returns how many bytes made it (n = all of them)
+    size_t write_all(int fd, const char* p, size_t n) {
+        size_t done = 0;
+        while (done < n) {
+            const ssize_t w = ::write(fd, p + done, n - done);
+            if (w < 0) break;
+            done += static_cast<size_t>(w);
+        }
+        return done;
+    }
+
+} // end anonymous namespace
+
+Journal::~Journal() { close(); }
+
+bool Journal::open(const std::string& path, const JournalOptions& opts) {
+    close();
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+
+    struct stat sb{};
+    if (::fstat(fd, &sb) != 0) { ::close(fd); return false; }
+    if (sb.st_size == 0) {
+        // brand new journal: stamp the header
+        JournalHeader h{};
+        std::memcpy(h.magic, kMagic, sizeof(kMagic));
+        h.version     = kVersion;
+        h.record_size = sizeof(Command);
+        if (write_all(fd, reinterpret_cast<const char*>(&h), sizeof(h)) != sizeof(h)) { ::close(fd); return false; }
+    } else {
+        // appending to an existing journal: it must have been written by a compatible build
+        JournalHeader h{};
+        if (::pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)) || !header_ok(h)) {
+            ::close(fd);
+            return false;
+        }
+        // a crash mid-write leaves a torn last record. replay skips it, but appending after it
+        // would shift every later record off the record grid: cut it off first
+        const size_t body  = static_cast<size_t>(sb.st_size) - sizeof(JournalHeader);
+        const size_t whole = sizeof(JournalHeader) + body / sizeof(Command) * sizeof(Command);
+        if (whole != static_cast<size_t>(sb.st_size) && ::ftruncate(fd, static_cast<off_t>(whole)) != 0) {
+            ::close(fd);
+            return false;
+        }
+    }
+
+    fd_   = fd;
+    opts_ = opts;
+    // at least one record fits, rounded down to whole records
+    const size_t cap = std::max(opts.buffer_bytes / sizeof(Command), size_t{1}) * sizeof(Command);
+    buf_.assign(cap, 0);
+    used_ = 0;
+    records_ = 0;
+    dropped_ = 0;
+    since_sync_ = 0;
+    failed_ = false;
+    return true;
+}
+
+void Journal::close() {
+    if (fd_ < 0) return;
+    sync();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+bool Journal::flush() {
+    if (fd_ < 0) return false;
+    const size_t done = write_all(fd_, buf_.data(), used_);
+    // whatever the OS did not take stays staged (moved to the front), for the next flush to retry
+    if (done < used_) std::memmove(buf_.data(), buf_.data() + done, used_ - done);
+    used_ -= done;
+    failed_ = used_ != 0;
+    return !failed_;
+}
+
+bool Journal::sync() {
+    since_sync_ = 0;
+    if (!flush()) return false;
+    return ::fsync(fd_) == 0;
+}
+
+JournalReplay Journal::replay(const std::string& path, OrderBook& book) {
+    JournalReplay out;
+    detail::MappedFile file(path.c_str());
+    if (!file.ok() || file.size() < sizeof(JournalHeader)) return out;
+
+    JournalHeader h{};
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (!header_ok(h)) return out;
+    out.ok = true;
+
+    // records sit right after the 16-byte header, so they are 8-byte aligned inside the
+    // page-aligned mapping and can be read in place. a torn tail record is dropped
+    const size_t n = (file.size() - sizeof(JournalHeader)) / sizeof(Command);
+    const auto* recs = reinterpret_cast<const Command*>(file.data() + sizeof(JournalHeader));
+
+    constexpr size_t kChunk = 4096;
+    ResultSink rs;
+    rs.acks.reserve(kChunk);
+    for (size_t i = 0; i < n; i += kChunk) {
+        const std::span<const Command> chunk(recs + i, std::min(kChunk, n - i));
+        rs.clear();
+        book.apply_batch(chunk, rs);
+        // only accepted commands were journaled, so every one must be accepted again with the same id
+        for (size_t k = 0; k < chunk.size(); ++k)
+            if (!rs.acks[k].ok || rs.acks[k].order_id != chunk[k].order_id) ++out.mismatches;
+        out.records += chunk.size();
+    }
+    return out;
+}
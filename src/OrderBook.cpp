@@ -1,14 +1,27 @@
-
 // T1: support non-crossing buy insert, cancel, best_bid/ask, depth_at
 #include "OrderBook.hpp"   // btw these are manually typed comments
-#include <map>             // ordered price -> agg_qty
-#include <list>
-#include <unordered_map>   // id -> ActiveOrder
+#include "BookState.hpp"   // Level, OrderNode, level slab + the two price ladders
+#include "Journal.hpp"     // write-ahead log of accepted commands
+#include "MappedFile.hpp"  // snapshot restore reads the file in place
+#include "Stats.hpp"       // compile-time-switchable counters behind stats()
+#include <cstdio>          // FILE* for snapshot writing, rename() into place
+#include <cstring>
+#include <filesystem>      // snapshot's directory, fsynced after the rename
+#include <limits>          // full price range for cancel_side
 #include <optional>
+#include <variant>         // one book = one of the ladder-specialized states
+#include <fcntl.h>         // open (the snapshot's directory)
+#include <unistd.h>        // fsync
 
 
 namespace {
 
+    using detail::kNil;
+    using detail::kStats;
+    using detail::EngineStats;
+    using detail::Level;
+    using detail::OrderNode;
+
     /**
      * @brief Minimal per-order metadata tracked while an order rests.
      *
@@ -24,321 +37,956 @@ namespace {
     };
 
     /**
-     * @brief A single resting order node within a price level's FIFO queue.
-     *
-     */
-    struct OrderNode {
-        uint64_t order_id;     ///< Engine-assigned unique order id
-        int64_t  remaining_qty;///< Unfilled quantity for this node
-        uint64_t ts;           ///< Submission timestamp (earlier = higher FIFO priority)
-    };
-
-    /**
-     * @brief One price level on one side of the book.
+     * @brief On-disk snapshot layout (native endianness; restore on the same architecture).
      *
-     * Maintains:
-     *  - @c aggregate_qty : sum of all node quantities at this price.
-     *  - @c queue         : FIFO of resting orders at this price, oldest at front.
+     *   SnapshotHeader
+     *   for every bid level (best first), then every ask level (best first):
+     *       SnapLevel, followed by its SnapLevel::count SnapOrders in FIFO order
+     *   uint32_t gens[slots]        generation of every order-pool slot
+     *   uint32_t free_order[free]   free slots in the order they will be handed out
      *
-     * @note We use @c std::list for stable iterators and O(1) erase given an iterator.
-     *       This property enables true O(1) cancel when coupled with stored iterators.
+     * The slot table is saved because order ids are (generation << 32) | slot: restoring it
+     * keeps resting ids valid and makes the ids of future orders identical to the original
+     * book's, so a journal tail can be replayed on top of a snapshot.
+     * Every record is a multiple of 8 bytes, so all of them can be read in place from the mapping.
      */
-    struct Level {
-        int64_t aggregate_qty = 0;       ///< Sum of remaining_qty for all nodes at this price
-        std::list<OrderNode> queue;      ///< FIFO queue of resting orders (price-time priority)
+    struct SnapshotHeader {
+        char     magic[8];     ///< "MNXSNAP" + '\0'
+        uint32_t version;      ///< kSnapshotVersion
+        uint32_t gen_floor;    ///< generation slots created after restore start at (see OrderPool::trim)
+        uint64_t bid_levels;
+        uint64_t ask_levels;
+        uint64_t orders;       ///< queued nodes across all levels (resting orders + tombstones)
+        uint64_t slots;        ///< order-pool slots (live + free)
+        uint64_t free;         ///< free slots
     };
-
-    /**
-     * @brief O(1) locator for a specific resting order.
-     *
-     * Stores the exact iterators needed to:
-     *  - locate the price level in the side map, and
-     *  - locate the order node inside that level's FIFO queue.
-     *
-     * With this handle, cancellation avoids both map lookup and queue scans.
-     *
-     * @warning Iterators are invalidated if the referenced element is erased.
-     *          Code that erases must ensure handles to that element are not used afterward.
-     */
-    struct Handle {
-        Side side;                                      ///< Side where the order rests
-        std::map<int64_t, Level>::iterator level_it;    ///< Iterator to (price -> Level) entry
-        std::list<OrderNode>::iterator      order_it;   ///< Iterator to the specific OrderNode in the Level queue
+    struct SnapLevel {
+        int64_t  px_ticks;
+        int64_t  aggregate_qty;
+        uint32_t count;        ///< orders that follow
+        uint32_t reserved;
     };
+    struct SnapOrder {
+        int64_t  remaining_qty; ///< 0 = tombstone (cancelled, not yet compacted) - kept so ids stay identical
+        uint64_t ts;
+        uint32_t slot;         ///< pool slot; the order id is (gens[slot] << 32) | slot
+        uint32_t reserved;
+    };
+    constexpr char     kSnapMagic[8]    = { 'M', 'N', 'X', 'S', 'N', 'A', 'P', '\0' };
+    constexpr uint32_t kSnapshotVersion = 3; // 2: SnapOrder::remaining_qty == 0 is a lazy-cancel tombstone,
+                                             // 3: SnapshotHeader::gen_floor
 
     /**
      * @brief Entire in-memory state of the order book.
      *
+     * @tparam Ladder price -> level index store (@c detail::MapLadder or @c detail::DenseLadder),
+     *                picked at construction through @c BookOptions::level_store.
+     *
      * Layout:
-     *  - @c bids : price -> Level, ordered ascending (highest price is @c std::prev(bids.end()))
-     *  - @c asks : price -> aggregate quantity (Level elided until DS step finishes)
-     *  - @c id_to_handle : order_id -> Handle for O(1) cancel
-     *  - @c next_id : monotonic id generator for new submissions
+     *  - @c bids / @c asks : price ladders mapping px_ticks -> index into @c levels
+     *  - @c levels : owns every Level (aggregate + FIFO head/tail) of both sides
+     *  - @c journal : optional write-ahead log; every accepted command is appended with its id
+     *  - @c stats : counters / histograms (only allocated when built with MINIEX_STATS)
+     *  - @c orders : owns every OrderNode; a node's slot index is the order's handle
+     *    (the node itself knows its side and level, so cancel needs nothing else).
+     *    It is also the id index: order ids are engine-generated as (generation << 32) | slot,
+     *    so cancel and fill bookkeeping are a single array access with stale-id detection
      *
-     * @invariant For every price present in @c bids, @c Level::aggregate_qty equals
-     *            the sum of @c remaining_qty over all nodes in @c Level::queue.
+     * @invariant For every price present in a ladder, @c Level::aggregate_qty equals
+     *            the sum of @c remaining_qty over all nodes linked from that level, and is > 0.
      *
      * @complexity
-     *  - Level lookup/creation: O(log L) where L is number of price levels on that side.
-     *  - Cancel by id: O(1) (amortized), given valid Handle iterators.
+     *  - Level lookup/creation: O(log L) with MapLadder, O(1) in the DenseLadder window.
+     *  - Cancel by id: O(1) (amortized), given a valid node slot.
      *
-     * @iterator_validity
-     *  - @c std::map iterators remain valid across insert/erase of different keys
-     *    (only the erased element’s iterator is invalidated).
-     *  - @c std::list iterators remain valid across insert/erase elsewhere; erasing the
-     *    node pointed to by @c order_it invalidates that iterator only.
+     * @index_validity
+     *  - Level indices stay valid until that level is released (ladders never move levels).
+     *  - Node slots stay valid until the order fills or is cancelled; the slot is then
+     *    recycled with a bumped generation, so the old id stops resolving.
      */
+    template <class Ladder>
     struct BookState {
-        std::map<int64_t, Level>             bids;          ///< Bid side: price -> Level (aggregate + FIFO)
-        std::map<int64_t, Level>           asks;          ///< Ask side: price -> aggregate (FIFO added in later DS step)
-        std::unordered_map<uint64_t, Handle> id_to_handle;  ///< O(1) jump to a resting order’s exact location
-        uint64_t                             next_id = 1;   ///< Next engine-generated order id
-    };
+        explicit BookState(const BookOptions& o) : opts(o), bids(Side::Buy, o), asks(Side::Sell, o) {
+            orders.reserve(preallocated_slots());
+        }
 
-    /**
-     * @brief Singleton accessor for the process-local book state.
-     *
-     * @return Reference to the single @c BookState instance.
-     *
-     * @note Returning by reference avoids copying and ensures mutations persist.
-     *       The static instance is constructed on first call (thread-unsafe lazy init).
-     */
-    BookState& S() {
-        static BookState s;   // constructed once on first use
-        return s;             // subsequent calls return the same instance
-    }
+        BookOptions                            opts;          ///< What this book was built with (restore rebuilds from it)
+        Ladder                                 bids;          ///< Bid side: price -> level index (best = highest)
+        Ladder                                 asks;          ///< Ask side: price -> level index (best = lowest)
+        detail::LevelSlab                      levels;        ///< Storage for every Level on both sides
+        detail::OrderPool                      orders;        ///< Storage for every OrderNode + id -> slot locator
+        Journal*                               journal = nullptr; ///< Not owned; nullptr = no journaling
+        std::optional<LevelSink>               level_sink;    ///< Not owned; nullopt = no L2 feed
+        std::vector<LevelUpdate>               l2_batch;      ///< Levels changed by the current command, one entry each
+        std::vector<uint32_t>                  l2_levels;     ///< Level index behind each l2_batch entry
+        uint64_t                               l2_seq = 0;    ///< Last L2 sequence number handed out
+        mutable detail::DepthCache             depth_cache[2]; ///< Top-N copies for depth(): [0] bids, [1] asks
+        size_t                                 tombstones = 0; ///< Lazy-cancelled nodes still linked somewhere
+        std::vector<uint32_t>                  mass_levels;   ///< Scratch for cancel_range: levels being dropped (reused)
+        std::vector<uint32_t>                  mass_slots;    ///< Scratch for cancel_all: ask slots the sweep defers (reused)
+        /// heap-allocated so a monitoring thread can keep reading it at a fixed address
+        std::unique_ptr<EngineStats>           stats = kStats ? std::make_unique<EngineStats>() : nullptr;
 
-} // end anonymous namespace
+        // order_capacity resting orders + the slot the order being matched holds for its id
+        size_t preallocated_slots() const { return opts.order_capacity ? opts.order_capacity + 1 : 0; }
 
+        Ladder&       ladder(Side side)       { return side == Side::Buy ? bids : asks; }
+        const Ladder& ladder(Side side) const { return side == Side::Buy ? bids : asks; }
 
-AddLimitResult OrderBook::add_limit(Side side, int64_t px_ticks, int64_t qty, uint64_t ts) {
-    AddLimitResult out{0, {}}; // order_id = 0, trades = {}. default that reprsents failure
-    if (qty <= 0 || px_ticks < 0) return out; // invalid trades
-    auto& st = S(); // Access the single BookState (internal memory)
-
-    // non-crossing BUY insert -> create node in a Level
-    if (side == Side::Buy) {
-        const uint64_t id = st.next_id++;  //engine generated ID
-        out.order_id = id;
-        // Performs single lookup/insert in O(log L)
-        // If p_ticks exists: returns an iterator to existing price->Level pair, sets inserted = false
-        // if not: constructs new Level{} at that key, returns iterator to it, sets inserted=true
-        auto [level_it, inserted] = st.bids.try_emplace(px_ticks, Level{});
-        // grab reference to Level object at that price
-        Level& level = level_it -> second; // level is a reference to second
-        // append to FIFO
-        level.queue.push_back(OrderNode{ id, qty, ts });
-        auto order_it = std::prev(level.queue.end());
-        // update aggregate
-        level.aggregate_qty += qty;
-        // record handle for O(1) cancel. id is order id
-        st.id_to_handle.emplace(id, Handle{ Side::Buy, level_it, order_it });
-        // no trades (non-crossing)
-        return out;
-    }
-    
-    // CROSSING sell
-    if (side == Side::Sell) {
-        // assign order id to incoming sell (taker)
-        const uint64_t taker_id = st.next_id++;
-        out.order_id = taker_id;
-        int64_t remaining = qty;
-        // while still have qty and crossable bid exists, cross
-        while (remaining > 0 && !st.bids.empty()) {
-            // best bid = highest price in bids
-            auto best_bid_it = std::prev(st.bids.end());
-            const int64_t best_bid_px = best_bid_it->first;
-            Level& level = best_bid_it->second;
-
-            if (best_bid_px < px_ticks) break; // no longer crossing
-
-            auto maker_it = level.queue.begin(); // starting at the best bid
-            const uint64_t maker_id = maker_it->order_id;
-            // amt that can fill
-            const int64_t fill = std::min<int64_t>(remaining, maker_it->remaining_qty);
-            // emit trade at the maker's (resting best bid) price
-            out.trades.push_back(Trade{
-                maker_id,/*maker_order_id=*/
-                taker_id,/*taker_order_id=*/
-                best_bid_px,/*px_ticks=*/
-                fill,/*qty=*/
-                ts/*ts=*/
+        // record an accepted command (with the id the engine gave it) before it is applied
+        void log(CommandType type, Side side, int64_t px_ticks, int64_t qty, uint64_t ts, uint64_t id,
+                 LimitType limit_type = LimitType::Day) {
+            if (journal) journal->append(Command{ type, side, px_ticks, qty, ts, id, limit_type });
+        }
+
+        // a level's aggregate_qty just changed: record its new value in this command's batch.
+        // the first touch claims an entry (Level::l2_slot), later ones overwrite it - coalescing
+        void l2_touch(Side side, uint32_t idx) {
+            if (!level_sink) return;
+            Level& level = levels[idx];
+            if (level.l2_slot == kNil) {
+                level.l2_slot = static_cast<uint32_t>(l2_batch.size());
+                l2_batch.push_back(LevelUpdate{ side, level.px_ticks, 0, 0 });
+                l2_levels.push_back(idx);
+            }
+            l2_batch[level.l2_slot].agg_qty = level.aggregate_qty;
+        }
+
+        // end of a command: number the batch and hand it to the sink in one call
+        void l2_flush() {
+            if (l2_batch.empty()) return;
+            for (uint32_t k = 0; k < l2_batch.size(); ++k) {
+                // the level may have been dropped (release clears l2_slot) or even reused by a
+                // later entry this command - only clear the mark if it is still ours
+                Level& level = levels[l2_levels[k]];
+                if (level.l2_slot == k) level.l2_slot = kNil;
+                l2_batch[k].seq = ++l2_seq;
+            }
+            (*level_sink)(l2_batch);
+            l2_batch.clear();
+            l2_levels.clear();
+        }
+
+        // every place a level's aggregate_qty changes calls this: depth cache + L2 feed
+        void level_changed(Side side, uint32_t idx) {
+            const Level& level = levels[idx];
+            depth_cache[side == Side::Buy ? 0 : 1].on_change(side, level.px_ticks, level.aggregate_qty);
+            l2_touch(side, idx);
+        }
+
+        // flushes the L2 batch when a command returns, whichever return it takes. declared before
+        // a command's OpTimer, so the timer stops first and the subscriber's callback isn't timed
+        struct L2Scope {
+            BookState& st;
+            ~L2Scope() { st.l2_flush(); }
+        };
+
+        // append the order in `slot` at the tail of (side, px), creating the level if needed
+        void rest(Side side, int64_t px_ticks, uint32_t slot, int64_t qty, uint64_t ts) {
+            Ladder& lad = ladder(side);
+            uint32_t idx = lad.find(px_ticks);
+            if (idx == kNil) {
+                idx = levels.acquire(px_ticks);
+                lad.insert(px_ticks, idx);
+                if constexpr (kStats) (side == Side::Buy ? stats->bid_levels : stats->ask_levels).add();
+            }
+            if constexpr (kStats) stats->resting_orders.add();
+            OrderNode& node = orders[slot];
+            node.remaining_qty = qty;
+            node.ts            = ts;
+            node.side          = side;
+            Level& level = levels[idx];
+            orders.push_back(level, idx, slot);
+            level.aggregate_qty += qty;
+            level_changed(side, idx);
+        }
+
+        // unlink + recycle a tombstone (its id was retired at cancel time)
+        void reclaim(Level& level, uint32_t slot) {
+            orders.unlink(level, slot);
+            orders.release(slot);
+            --level.dead;
+            --tombstones;
+        }
+
+        // one walk of the level's queue, reclaiming every tombstone in it
+        void purge(uint32_t idx) {
+            Level& level = levels[idx];
+            for (uint32_t i = level.head; i != kNil && level.dead > 0;) {
+                const uint32_t next = orders[i].next;
+                if (orders[i].remaining_qty == 0) reclaim(level, i);
+                i = next;
+            }
+        }
+
+        // explicit compaction: purge every level that still holds tombstones (one pass over the ladders)
+        size_t compact_all() {
+            const size_t before = tombstones;
+            auto purge_dead = [this](uint32_t idx) { if (levels[idx].dead > 0) purge(idx); return tombstones > 0; };
+            bids.for_each(purge_dead);
+            asks.for_each(purge_dead);
+            return before - tombstones;
+        }
+
+        // if the price level is now empty, take it out of the ladder and recycle it
+        // (tombstones still queued there go with it)
+        void drop_if_empty(Side side, uint32_t idx) {
+            Level& level = levels[idx];
+            if (level.aggregate_qty != 0) return;
+            if (level.dead > 0) purge(idx);
+            ladder(side).erase(level.px_ticks);
+            levels.release(idx);
+            if constexpr (kStats) (side == Side::Buy ? stats->bid_levels : stats->ask_levels).sub();
+        }
+
+        template <Side S>
+        Ladder& ladder_of() {
+            if constexpr (S == Side::Buy) return bids;
+            else                          return asks;
+        }
+
+        /**
+         * @brief The matching kernel: an incoming order on side @c S takes fills from the FIFO
+         *        front of the opposite side's best level.
+         *
+         * Stops when @c remaining is used up, the opposite side is empty, or (Kind == Limit)
+         * the best opposite price no longer crosses @c limit_px. One instantiation per
+         * (side, kind): the ladder, its best end and the price comparison are all fixed at
+         * compile time, so the fill loop has no side / order-type branches left in it.
+         * @return quantity left unfilled
+         */
+        template <Side S, detail::OrderKind Kind, class Sink>
+        int64_t match(uint64_t taker_id, int64_t remaining, int64_t limit_px, uint64_t ts, Sink& on_trade) {
+            constexpr Side book_side = detail::SideTraits<S>::opposite;
+            Ladder& lad = ladder_of<book_side>();
+            [[maybe_unused]] uint64_t n_levels = 0, n_trades = 0;
+            [[maybe_unused]] uint32_t last_idx = kNil;
+            while (remaining > 0) {
+                const uint32_t idx = lad.template best<book_side>();
+                if (idx == kNil) break;
+                Level& level = levels[idx];
+                if constexpr (Kind == detail::OrderKind::Limit)
+                    if (!detail::SideTraits<S>::crosses(level.px_ticks, limit_px)) break; // no longer crossing
+                const uint32_t maker_slot = level.head; // FIFO: oldest order at the best price
+                OrderNode& maker = orders[maker_slot];
+                // lazy-cancel tombstone at the front: reclaim it on the way past (the level still
+                // has live qty, so a live order follows)
+                if (maker.remaining_qty == 0) { reclaim(level, maker_slot); continue; }
+                if constexpr (kStats) { n_levels += idx != last_idx; last_idx = idx; ++n_trades; }
+
+                const uint64_t maker_id = orders.id_of(maker_slot);
+                // amt that can fill against this maker
+                const int64_t fill = std::min<int64_t>(remaining, maker.remaining_qty);
+                // emit trade at the maker's (resting) price - handed to the sink as it happens
+                on_trade(Trade{
+                    maker_id,/*maker_order_id=*/
+                    taker_id,/*taker_order_id=*/
+                    level.px_ticks,/*px_ticks=*/
+                    fill,/*qty=*/
+                    ts/*ts=*/
+                });
+                // apply the effects of the fill
+                maker.remaining_qty -= fill;
+                level.aggregate_qty -= fill;
+                remaining           -= fill;
+                level_changed(book_side, idx);
+                // if maker completed, unlink node and recycle its slot - that also retires its id (O(1))
+                if (maker.remaining_qty == 0) {
+                    orders.unlink(level, maker_slot);
+                    orders.release(maker_slot);
+                    if constexpr (kStats) stats->resting_orders.sub();
+                }
+                drop_if_empty(book_side, idx);
+            }
+            if constexpr (kStats) {
+                if (n_trades > 0) {
+                    stats->aggressive_orders.add();
+                    stats->levels_touched.add(n_levels);
+                    stats->max_levels_touched.max(n_levels);
+                    stats->trades.add(n_trades);
+                    stats->max_trades.max(n_trades);
+                }
+            }
+            return remaining;
+        }
+
+        // match the limit order in `slot` at px_ticks, then rest whatever is left in the same slot
+        // (IOC / FOK: drop it instead). not resting -> recycling the slot retires the id
+        template <Side S, class Sink>
+        void place(int64_t px_ticks, uint32_t slot, int64_t qty, uint64_t ts, bool rest_leftover, Sink& on_trade) {
+            // while still have qty and the opposite best crosses our limit, trade
+            const int64_t remaining = match<S, detail::OrderKind::Limit>(orders.id_of(slot), qty, px_ticks, ts, on_trade);
+            // leftover rests on our own side (FIFO node); the slot doubles as the O(1) cancel handle
+            if (remaining > 0 && rest_leftover) rest(S, px_ticks, slot, remaining, ts);
+            else                            orders.release(slot);
+        }
+
+        // the one runtime side branch on the limit path: pick the instantiation
+        template <class Sink>
+        void place(Side side, int64_t px_ticks, uint32_t slot, int64_t qty, uint64_t ts, bool rest_leftover, Sink& on_trade) {
+            if (side == Side::Buy) place<Side::Buy>(px_ticks, slot, qty, ts, rest_leftover, on_trade);
+            else                   place<Side::Sell>(px_ticks, slot, qty, ts, rest_leftover, on_trade);
+        }
+
+        // would a side-S order at limit_px trade with the book right now? (best level only)
+        template <Side S>
+        bool would_cross(int64_t limit_px) const {
+            constexpr Side book_side = detail::SideTraits<S>::opposite;
+            const uint32_t idx = ladder(book_side).template best<book_side>();
+            return idx != kNil && detail::SideTraits<S>::crosses(levels[idx].px_ticks, limit_px);
+        }
+
+        // FOK pre-check: can a side-S order at limit_px fill qty in full right now? read-only:
+        // sums the cached Level::aggregate_qty best-first, stops at the limit or once qty is covered
+        template <Side S>
+        bool can_fill(int64_t limit_px, int64_t qty) const {
+            constexpr Side book_side = detail::SideTraits<S>::opposite;
+            int64_t avail = 0;
+            ladder(book_side).for_each([&](uint32_t idx) {
+                const Level& level = levels[idx];
+                if (!detail::SideTraits<S>::crosses(level.px_ticks, limit_px)) return false;
+                avail += level.aggregate_qty;
+                return avail < qty;
             });
-            // apply the effects of the fill
-            maker_it->remaining_qty -= fill;
-            level.aggregate_qty     -= fill;
-            remaining               -= fill;
-            // if maker completed, erase node and its handle (O(1))
-            if (maker_it->remaining_qty == 0) {
-                st.id_to_handle.erase(maker_id);
-                level.queue.erase(maker_it);
+            return avail >= qty;
+        }
+
+        // IOC / FOK / post-only admission, before anything is taken or logged
+        bool admit(Side side, int64_t px_ticks, int64_t qty, LimitType type) const {
+            switch (type) {
+                case LimitType::PostOnly:
+                    return side == Side::Buy ? !would_cross<Side::Buy>(px_ticks) : !would_cross<Side::Sell>(px_ticks);
+                case LimitType::FOK:
+                    return side == Side::Buy ? can_fill<Side::Buy>(px_ticks, qty) : can_fill<Side::Sell>(px_ticks, qty);
+                default:
+                    return true;
+            }
+        }
+
+        // returns the engine order id (0 = rejected); fills go to on_trade
+        template <class Sink>
+        uint64_t add_limit(Side side, int64_t px_ticks, int64_t qty, uint64_t ts, LimitType type, Sink& on_trade) {
+            L2Scope l2{ *this };
+            [[maybe_unused]] detail::OpTimer<> timer(stats.get(), &EngineStats::add_limit);
+            if (qty <= 0 || px_ticks < 0) return 0; // invalid trades
+            // FOK that cannot fill / post-only that would cross: rejected with the book untouched
+            if (!admit(side, px_ticks, qty, type)) return 0;
+
+            // every accepted limit order takes a node slot up front; the slot is its id
+            const uint32_t slot = orders.acquire();
+            // assign order id to incoming order (taker, if it crosses) before it can be released
+            const uint64_t id = orders.id_of(slot);
+            log(CommandType::AddLimit, side, px_ticks, qty, ts, id, type);
+            // post-only passed admit(), so it matches nothing and rests; FOK passed, so it fills
+            const bool rests = type == LimitType::Day || type == LimitType::PostOnly;
+            place(side, px_ticks, slot, qty, ts, rests, on_trade);
+            return id;  //engine generated ID
+        }
+
+        // market orders never rest, any leftover remaining (ie: other side ran out) goes unfilled
+        // returns the taker id (0 = rejected); fills go to on_trade
+        template <class Sink>
+        uint64_t add_market(Side side, int64_t qty, uint64_t ts, Sink& on_trade) {
+            L2Scope l2{ *this };
+            [[maybe_unused]] detail::OpTimer<> timer(stats.get(), &EngineStats::add_market);
+            if (qty <= 0) return 0; // reject
+            // give submission temp taker id for attribution in trades: borrow a slot for its id,
+            // and hand it straight back afterwards so the id can never be cancelled
+            const uint32_t slot = orders.acquire();
+            const uint64_t taker_id = orders.id_of(slot);
+            log(CommandType::AddMarket, side, 0, qty, ts, taker_id);
+            // Buy walks asks from lowest price outward; Sell walks bids from highest outward
+            if (side == Side::Buy) match<Side::Buy,  detail::OrderKind::Market>(taker_id, qty, 0, ts, on_trade);
+            else                   match<Side::Sell, detail::OrderKind::Market>(taker_id, qty, 0, ts, on_trade);
+            orders.release(slot);
+            return taker_id;
+        }
+
+        bool cancel(uint64_t order_id) {
+            L2Scope l2{ *this };
+            [[maybe_unused]] detail::OpTimer<> timer(stats.get(), &EngineStats::cancel);
+            // decode order_id -> slot and check its generation; unknown / stale -> false
+            const uint32_t slot = orders.locate(order_id);
+            if (slot == kNil) {
+                if constexpr (kStats) stats->cancel_misses.add();
+                return false;
             }
-            // if the price level is now empty, erase it 
-            if (level.aggregate_qty == 0) {
-                st.bids.erase(best_bid_it);
+            if constexpr (kStats) { stats->cancel_hits.add(); stats->resting_orders.sub(); }
+
+            OrderNode& node = orders[slot];
+            log(CommandType::Cancel, node.side, 0, 0, 0, order_id);
+            const Side     side      = node.side;
+            const uint32_t level_idx = node.level;
+            Level& level = levels[level_idx];
+            // subtract remaining qty from aggregate
+            level.aggregate_qty -= node.remaining_qty;
+            level_changed(side, level_idx);
+            if (opts.lazy_cancel) {
+                // leave the node queued as a tombstone: the id dies now, the unlink happens later
+                node.remaining_qty = 0;
+                orders.retire(slot);
+                ++level.dead;
+                ++tombstones;
+                // one walk per batch of >= compact_min tombstones that are at least half the queue:
+                // amortized O(1) per cancel, however deep the level is
+                if (level.aggregate_qty == 0) drop_if_empty(side, level_idx);
+                else if (level.dead >= opts.compact_min && level.dead * 2 >= level.count) purge(level_idx);
+                return true;
             }
+            // unlink order node in O(1) and recycle its slot
+            orders.unlink(level, slot);
+            orders.release(slot);
+            // if level empty, erase price level
+            drop_if_empty(side, level_idx);
+            return true;
         }
-        // if any sell doesn't cross, rest it on ask side (FIFO node + handle)
-        if (remaining > 0) {
-            auto [ask_level_it, inserted] = st.asks.try_emplace(px_ticks, Level{});
-            Level& ask_level = ask_level_it->second;
-            // push_back appends to end of container
-            ask_level.queue.push_back(OrderNode{ /*order_id=*/taker_id, /*remaining_qty=*/remaining, /*ts=*/ts });
-            auto order_it = std::prev(ask_level.queue.end());
 
-            ask_level.aggregate_qty += remaining;
-            st.id_to_handle.emplace(taker_id, Handle{ Side::Sell, ask_level_it, order_it });
+        // mass cancel: collect the levels of `side` inside [lo, hi], then for each one walk its queue
+        // once (retire every id, recycle every slot) and drop the level whole - no per-order unlink,
+        // no per-order aggregate update. a whole side that holds a good share of the slot table
+        // skips the queue walks (linear slot sweep instead); a whole side is cleared from the
+        // ladder in one call
+        size_t cancel_range(Side side, int64_t lo, int64_t hi, std::vector<uint64_t>* cancelled) {
+            L2Scope l2{ *this };
+            return mass_cancel(side, lo, hi, cancelled);
         }
-    }
+
+        // cancel_range without its own L2Scope: the caller's scope publishes one batch per command
+        size_t mass_cancel(Side side, int64_t lo, int64_t hi, std::vector<uint64_t>* cancelled) {
+            const size_t queued = collect_levels(side, lo, hi);
+            if (mass_levels.empty()) return 0;
+            log(CommandType::CancelRange, side, lo, hi, 0, 0);
+
+            const bool whole_side = mass_levels.size() == ladder(side).size();
+            size_t n = 0;
+            if (whole_side && sweep_pays(queued)) {
+                for (uint32_t i = 0; i < orders.size(); ++i)
+                    if (orders[i].level != kNil && orders[i].side == side) n += release_cancelled(i, cancelled);
+            } else {
+                for (uint32_t idx : mass_levels) {
+                    for (uint32_t i = levels[idx].head; i != kNil;) {
+                        const uint32_t next = orders[i].next; // release() reuses the link for the free list
+                        n += release_cancelled(i, cancelled);
+                        i = next;
+                    }
+                }
+            }
+            drop_levels(side, whole_side);
+            if constexpr (kStats) stats->resting_orders.sub(n);
+            return n;
+        }
+
+        // both sides. when both would be swept, one pass over the slot table does it: bid slots are
+        // released as the pass meets them, ask slots right after, in slot order - the same free-list
+        // order (so the same future ids) as the two journaled per-side CancelRange records give on replay
+        size_t cancel_all(std::vector<uint64_t>* cancelled) {
+            constexpr int64_t kLo = std::numeric_limits<int64_t>::min(), kHi = std::numeric_limits<int64_t>::max();
+            L2Scope l2{ *this };
+            const size_t bid_q = queued_on(Side::Buy), ask_q = queued_on(Side::Sell);
+            if (bid_q == 0 || ask_q == 0 || !sweep_pays(bid_q) || !sweep_pays(ask_q)) {
+                const size_t n = mass_cancel(Side::Buy, kLo, kHi, cancelled);
+                return n + mass_cancel(Side::Sell, kLo, kHi, cancelled);
+            }
+
+            log(CommandType::CancelRange, Side::Buy, kLo, kHi, 0, 0);
+            log(CommandType::CancelRange, Side::Sell, kLo, kHi, 0, 0);
+            size_t n = 0;
+            mass_slots.clear();
+            for (uint32_t i = 0; i < orders.size(); ++i) {
+                if (orders[i].level == kNil) continue;
+                if (orders[i].side == Side::Sell) mass_slots.push_back(i);
+                else                              n += release_cancelled(i, cancelled);
+            }
+            for (uint32_t i : mass_slots) n += release_cancelled(i, cancelled);
+            for (Side side : { Side::Buy, Side::Sell }) {
+                collect_levels(side, kLo, kHi);
+                drop_levels(side, /*whole_side=*/true);
+            }
+            if constexpr (kStats) stats->resting_orders.sub(n);
+            return n;
+        }
+
+        // levels of `side` inside [lo, hi] into mass_levels, best first; returns the nodes they queue
+        size_t collect_levels(Side side, int64_t lo, int64_t hi) {
+            mass_levels.clear();
+            size_t queued = 0;
+            ladder(side).for_each([&](uint32_t idx) {
+                const int64_t px = levels[idx].px_ticks;
+                // best first: bids come down from the top, asks up from the bottom
+                if (side == Side::Buy ? px < lo : px > hi) return false;
+                if (px >= lo && px <= hi) { mass_levels.push_back(idx); queued += levels[idx].count; }
+                return true;
+            });
+            return queued;
+        }
+
+        size_t queued_on(Side side) const {
+            size_t queued = 0;
+            ladder(side).for_each([&](uint32_t idx) { queued += levels[idx].count; return true; });
+            return queued;
+        }
+
+        // one sequential sweep of the slot table beats walking queues whose nodes sit all over the
+        // pool - but only while the orders going away are a good share of the slots it reads
+        bool sweep_pays(size_t queued) const { return queued * 4 >= orders.size(); }
+
+        // retire + recycle one queued node of a mass cancel; 1 if it was a live order (tombstones
+        // were already cancelled, they are only reclaimed here)
+        size_t release_cancelled(uint32_t i, std::vector<uint64_t>* cancelled) {
+            const bool live = orders[i].remaining_qty > 0;
+            if (live && cancelled) cancelled->push_back(orders.id_of(i));
+            orders.release(i);
+            return live;
+        }
+
+        // the levels in mass_levels have had every node released: publish them as gone and drop them
+        void drop_levels(Side side, bool whole_side) {
+            Ladder& lad = ladder(side);
+            for (uint32_t idx : mass_levels) {
+                Level& level = levels[idx];
+                tombstones -= level.dead;
+                level.head = level.tail = kNil;
+                level.count = level.dead = 0;
+                level.aggregate_qty = 0;
+                level_changed(side, idx);
+                if (!whole_side) lad.erase(level.px_ticks);
+                levels.release(idx);
+            }
+            if (whole_side) lad.clear();
+            if constexpr (kStats) (side == Side::Buy ? stats->bid_levels : stats->ask_levels).sub(mass_levels.size());
+        }
+
+        // explicit compaction (idle time). journaled when it does anything, since it decides
+        // which slots - so which ids - the next orders get
+        size_t compact() {
+            if (tombstones == 0) return 0;
+            log(CommandType::Compact, Side::Buy, 0, 0, 0, 0);
+            return compact_all();
+        }
+
+        // release pooled memory. the order-slot trim is journaled (when there is one) for the same
+        // reason compact() is: it changes which slots future orders get
+        size_t shrink() {
+            const size_t before = memory_usage().total();
+            compact();
+            if (orders.trimmable(preallocated_slots()) != 0) {
+                log(CommandType::Shrink, Side::Buy, 0, 0, 0, 0);
+                orders.trim(preallocated_slots());
+            }
+            levels.trim();
+            bids.shrink();
+            asks.shrink();
+            for (auto* v : { &l2_levels, &mass_levels, &mass_slots }) { v->clear(); v->shrink_to_fit(); }
+            l2_batch.clear();
+            l2_batch.shrink_to_fit();
+            return before - memory_usage().total();
+        }
+
+        // same price + qty down: shrink in place (FIFO position kept). otherwise the node leaves its
+        // level and goes back through place() under the same slot - relinked, never reallocated
+        template <class Sink>
+        bool amend(uint64_t order_id, int64_t new_qty, int64_t new_px, uint64_t ts, Sink& on_trade) {
+            L2Scope l2{ *this };
+            [[maybe_unused]] detail::OpTimer<> timer(stats.get(), &EngineStats::amend);
+            if (new_qty <= 0 || new_px < 0) return false;
+            const uint32_t slot = orders.locate(order_id);
+            if (slot == kNil) return false;
+
+            OrderNode& node = orders[slot];
+            const Side     side      = node.side;
+            const uint32_t level_idx = node.level;
+            Level& level = levels[level_idx];
+            log(CommandType::Amend, side, new_px, new_qty, ts, order_id);
+
+            if (new_px == level.px_ticks && new_qty <= node.remaining_qty) {
+                // reduce only: priority is kept, nothing moves
+                level.aggregate_qty -= node.remaining_qty - new_qty;
+                node.remaining_qty   = new_qty;
+                level_changed(side, level_idx);
+                return true;
+            }
+            if (new_px == level.px_ticks) {
+                // qty up at the same price: loses priority, back of the same queue (the level stays)
+                level.aggregate_qty += new_qty - node.remaining_qty;
+                node.remaining_qty   = new_qty;
+                node.ts              = ts;
+                level_changed(side, level_idx);
+                orders.unlink(level, slot);
+                orders.push_back(level, level_idx, slot);
+                return true;
+            }
+            // new price: take it off the old level, then treat it as a limit order at new_px
+            level.aggregate_qty -= node.remaining_qty;
+            level_changed(side, level_idx);
+            orders.unlink(level, slot);
+            drop_if_empty(side, level_idx);
+            if constexpr (kStats) stats->resting_orders.sub();
+            place(side, new_px, slot, new_qty, ts, /*rest_leftover=*/true, on_trade);
+            return true;
+        }
+
+        // one pass over the burst: no per-command dispatch, trades land in one reused buffer,
+        // and the node of a cancel a few commands ahead is prefetched while we match this one
+        void apply_batch(std::span<const Command> cmds, ResultSink& out) {
+            constexpr size_t kPrefetchAhead = 4;
+            auto collect = [&out](const Trade& t) { out.trades.push_back(t); };
+            for (size_t i = 0; i < cmds.size(); ++i) {
+                if (i + kPrefetchAhead < cmds.size() && cmds[i + kPrefetchAhead].type == CommandType::Cancel)
+                    orders.prefetch(cmds[i + kPrefetchAhead].order_id);
+
+                const auto first = static_cast<uint32_t>(out.trades.size());
+                CommandAck ack = dispatch(cmds[i], collect);
+                ack.first_trade = first;
+                ack.trade_count = static_cast<uint32_t>(out.trades.size()) - first;
+                out.acks.push_back(ack);
+            }
+        }
+
+        // the one CommandType switch: apply_batch, OrderBook::dispatch and everything built on it
+        // (sequencer, replay tools) go through here. trade placement in the ack is the caller's
+        template <class Sink>
+        CommandAck dispatch(const Command& c, Sink& on_trade) {
+            uint64_t id = 0;
+            bool ok = false;   // set directly by the types that are always accepted (and ack id 0)
+            switch (c.type) {
+                case CommandType::AddLimit:    id = add_limit(c.side, c.px_ticks, c.qty, c.ts, c.limit_type, on_trade); break;
+                case CommandType::AddMarket:   id = add_market(c.side, c.qty, c.ts, on_trade); break;
+                case CommandType::Cancel:      id = cancel(c.order_id) ? c.order_id : 0; break;
+                case CommandType::Amend:       id = amend(c.order_id, c.qty, c.px_ticks, c.ts, on_trade) ? c.order_id : 0; break;
+                case CommandType::Compact:     compact(); ok = true; break;
+                case CommandType::CancelRange: cancel_range(c.side, c.px_ticks, c.qty, nullptr); ok = true; break;
+                case CommandType::Shrink:      shrink(); ok = true; break;
+            }
+            return CommandAck{ id, 0, 0, ok || id != 0 };
+        }
+
+        std::optional<TopOfBook> top(Side side) const {
+            const uint32_t idx = ladder(side).best();
+            if (idx == kNil) return std::nullopt;
+            const Level& level = levels[idx];
+            return TopOfBook{ level.px_ticks, level.aggregate_qty };
+        }
+
+        PoolStats pool_stats() const {
+            PoolStats p = orders.stats();
+            p.tombstones = tombstones;
+            return p;
+        }
+
+        MemoryUsage memory_usage() const {
+            MemoryUsage m{};
+            m.orders      = orders.bytes();
+            m.levels      = levels.bytes();
+            m.price_index = bids.bytes() + asks.bytes();
+            m.scratch     = l2_batch.capacity() * sizeof(LevelUpdate)
+                          + (l2_levels.capacity() + mass_levels.capacity() + mass_slots.capacity()) * sizeof(uint32_t)
+                          + depth_cache[0].bytes() + depth_cache[1].bytes();
+            return m;
+        }
+
+        BookStats read_stats() const {
+            BookStats out{};
+            out.enabled = kStats;
+            if constexpr (kStats) {
+                const EngineStats& s = *stats;
+                s.add_limit.read(out.add_limit);
+                s.add_market.read(out.add_market);
+                s.cancel.read(out.cancel);
+                s.amend.read(out.amend);
+                out.aggressive_orders  = s.aggressive_orders.get();
+                out.levels_touched     = s.levels_touched.get();
+                out.max_levels_touched = s.max_levels_touched.get();
+                out.trades             = s.trades.get();
+                out.max_trades         = s.max_trades.get();
+                out.cancel_hits        = s.cancel_hits.get();
+                out.cancel_misses      = s.cancel_misses.get();
+                out.resting_orders     = s.resting_orders.get();
+                out.bid_levels         = s.bid_levels.get();
+                out.ask_levels         = s.ask_levels.get();
+            } else {
+                // no counters compiled in: read the shape straight off the containers
+                out.resting_orders = orders.stats().live - tombstones;
+                out.bid_levels     = bids.size();
+                out.ask_levels     = asks.size();
+            }
+            return out;
+        }
+
+        // write levels (best first, FIFO preserved) + the pool's slot table to path.
+        // written to path.tmp, fsynced, then renamed over path: a crash mid-snapshot leaves the
+        // previous snapshot in place, never a truncated one
+        bool snapshot(const std::string& path) const {
+            const std::string tmp = path + ".tmp";
+            std::FILE* f = std::fopen(tmp.c_str(), "wb");
+            if (!f) return false;
+            std::setvbuf(f, nullptr, _IOFBF, 1 << 20);
+
+            SnapshotHeader h{};
+            std::memcpy(h.magic, kSnapMagic, sizeof(kSnapMagic));
+            h.version = kSnapshotVersion;
+            h.gen_floor = orders.gen_floor();
+            bids.for_each([&](uint32_t idx) { ++h.bid_levels; h.orders += levels[idx].count; return true; });
+            asks.for_each([&](uint32_t idx) { ++h.ask_levels; h.orders += levels[idx].count; return true; });
+            h.slots = orders.size();
+            orders.for_each_free([&](uint32_t) { ++h.free; });
+            bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+
+            auto write_level = [&](uint32_t idx) {
+                const Level& level = levels[idx];
+                const SnapLevel sl{ level.px_ticks, level.aggregate_qty, level.count, 0 };
+                ok = ok && std::fwrite(&sl, sizeof(sl), 1, f) == 1;
+                for (uint32_t i = level.head; i != kNil && ok; i = orders[i].next) {
+                    const SnapOrder so{ orders[i].remaining_qty, orders[i].ts, i, 0 };
+                    ok = std::fwrite(&so, sizeof(so), 1, f) == 1;
+                }
+                return ok;
+            };
+            bids.for_each(write_level);
+            asks.for_each(write_level);
+
+            std::vector<uint32_t> table;
+            table.reserve(h.slots + h.free);
+            for (uint32_t i = 0; i < h.slots; ++i) table.push_back(orders.gen(i));
+            orders.for_each_free([&](uint32_t i) { table.push_back(i); });
+            // (an empty book may have no slots at all: fwrite must not see a null buffer)
+            if (!table.empty()) ok = ok && std::fwrite(table.data(), sizeof(uint32_t), table.size(), f) == table.size();
+            ok = ok && std::fflush(f) == 0 && ::fsync(::fileno(f)) == 0;
+            ok = std::fclose(f) == 0 && ok;
+            if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+                std::remove(tmp.c_str());
+                return false;
+            }
+            // make the rename itself durable
+            const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+            const int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+            if (dfd >= 0) { ::fsync(dfd); ::close(dfd); }
+            return true;
+        }
+
+        // rebuild from a mapped snapshot into a fresh state, then swap it in.
+        // one ladder insert per level; orders are linked straight into their saved slots
+        bool restore(const std::string& path) {
+            detail::MappedFile file(path.c_str());
+            if (!file.ok() || file.size() < sizeof(SnapshotHeader)) return false;
+            SnapshotHeader h;
+            std::memcpy(&h, file.data(), sizeof(h));
+            if (std::memcmp(h.magic, kSnapMagic, sizeof(kSnapMagic)) != 0 || h.version != kSnapshotVersion) return false;
+            // sizes must add up exactly, and fit the 32-bit slot space
+            if (h.slots >= kNil || h.free > h.slots || h.orders != h.slots - h.free || h.gen_floor == 0) return false;
+            // every level holds at least one order: bounds the level counts before they are multiplied
+            if (h.bid_levels > h.orders || h.ask_levels > h.orders - h.bid_levels) return false;
+            const uint64_t expect = sizeof(SnapshotHeader) + (h.bid_levels + h.ask_levels) * sizeof(SnapLevel)
+                                  + h.orders * sizeof(SnapOrder) + (h.slots + h.free) * sizeof(uint32_t);
+            if (expect != file.size()) return false;
+
+            const char* cur = file.data() + sizeof(SnapshotHeader);
+            const auto* table = reinterpret_cast<const uint32_t*>(file.data() + file.size() - (h.slots + h.free) * sizeof(uint32_t));
+            for (uint64_t k = 0; k < h.free; ++k) if (table[h.slots + k] >= h.slots) return false;
+
+            BookState fresh(opts);
+            fresh.journal = journal;
+            fresh.level_sink = level_sink;
+            fresh.l2_seq = l2_seq;
+            fresh.orders.restore(table, h.slots, table + h.slots, h.free, h.gen_floor);
+
+            uint64_t seen = 0;
+            auto load_side = [&](Side side, uint64_t n_levels) {
+                int64_t prev_px = 0;
+                for (uint64_t l = 0; l < n_levels; ++l) {
+                    const auto* sl = reinterpret_cast<const SnapLevel*>(cur);
+                    cur += sizeof(SnapLevel);
+                    // strictly best-first, no empty levels, no duplicate prices
+                    if (sl->count == 0 || sl->aggregate_qty <= 0 || sl->px_ticks < 0 || seen + sl->count > h.orders) return false;
+                    if (l > 0 && (side == Side::Buy ? sl->px_ticks >= prev_px : sl->px_ticks <= prev_px)) return false;
+                    prev_px = sl->px_ticks;
+
+                    const uint32_t idx = fresh.levels.acquire(sl->px_ticks);
+                    fresh.ladder(side).insert(sl->px_ticks, idx);
+                    Level& level = fresh.levels[idx];
+                    for (uint32_t k = 0; k < sl->count; ++k) {
+                        const auto* so = reinterpret_cast<const SnapOrder*>(cur);
+                        cur += sizeof(SnapOrder);
+                        // each slot at most once, and never one that is also free
+                        if (so->slot >= h.slots || so->remaining_qty < 0 || fresh.orders[so->slot].level != kNil) return false;
+                        OrderNode& node = fresh.orders[so->slot];
+                        node.remaining_qty = so->remaining_qty;
+                        node.ts            = so->ts;
+                        node.side          = side;
+                        fresh.orders.push_back(level, idx, so->slot);
+                        level.aggregate_qty += so->remaining_qty;
+                        if (so->remaining_qty == 0) ++level.dead;
+                    }
+                    fresh.tombstones += level.dead;
+                    if (level.aggregate_qty != sl->aggregate_qty) return false;
+                    seen += sl->count;
+                }
+                return true;
+            };
+            if (!load_side(Side::Buy, h.bid_levels) || !load_side(Side::Sell, h.ask_levels) || seen != h.orders) return false;
+            bool free_ok = true;
+            fresh.orders.for_each_free([&](uint32_t i) { free_ok = free_ok && fresh.orders[i].level == kNil; });
+            if (!free_ok) return false;
+
+            // keep our counters (a monitoring thread may hold on to them); re-seat the gauges
+            if constexpr (kStats) {
+                stats->resting_orders.set(h.orders - fresh.tombstones);
+                stats->bid_levels.set(h.bid_levels);
+                stats->ask_levels.set(h.ask_levels);
+                fresh.stats = std::move(stats);
+            }
+            *this = std::move(fresh);
+            return true;
+        }
+
+        size_t depth(Side side, size_t n, std::span<TopOfBook> out) const {
+            return depth_cache[side == Side::Buy ? 0 : 1].read(ladder(side), levels, n, out);
+        }
+
+        // get level size, return 0 if missing
+        int64_t depth_at(Side side, int64_t px_ticks) const {
+            const uint32_t idx = ladder(side).find(px_ticks);
+            return idx == kNil ? 0 : levels[idx].aggregate_qty;
+        }
+    };
+
+} // end anonymous namespace
+
+/**
+ * @brief Per-instance state behind the pimpl in OrderBook.hpp.
+ *
+ * Each @c OrderBook owns exactly one of these, so separate books (one per
+ * instrument) never share levels, queues or ids. The variant holds the state
+ * specialized for the ladder chosen in @c BookOptions; every public call is one
+ * @c std::visit into it.
+ */
+struct OrderBook::Impl {
+    std::variant<BookState<detail::MapLadder>, BookState<detail::DenseLadder>> st;
+
+    explicit Impl(const BookOptions& opts)
+        : st(opts.level_store == LevelStore::Dense
+                 ? decltype(st){ std::in_place_index<1>, opts }
+                 : decltype(st){ std::in_place_index<0>, opts }) {}
+};
+
+OrderBook::OrderBook() : OrderBook(BookOptions{}) {}
+OrderBook::OrderBook(const BookOptions& opts) : impl_(std::make_unique<Impl>(opts)) {}
+OrderBook::~OrderBook() = default;
+OrderBook::OrderBook(OrderBook&&) noexcept = default;
+OrderBook& OrderBook::operator=(OrderBook&&) noexcept = default;
+
+
+// vector-returning wrappers: same matching path, the sink just appends to the result (tests / convenience)
+AddLimitResult OrderBook::add_limit(Side side, int64_t px_ticks, int64_t qty, uint64_t ts, LimitType type) {
+    AddLimitResult out{0, {}}; // order_id = 0, trades = {}. default that reprsents failure
+    auto collect = [&out](const Trade& t) { out.trades.push_back(t); };
+    out.order_id = std::visit([&](auto& st) { return st.add_limit(side, px_ticks, qty, ts, type, collect); }, impl_->st);
+    return out;
+}
+
+AddMarketResult OrderBook::add_market(Side side, int64_t qty, uint64_t ts) {
+    AddMarketResult out{0, {}};
+    auto collect = [&out](const Trade& t) { out.trades.push_back(t); };
+    out.taker_order_id = std::visit([&](auto& st) { return st.add_market(side, qty, ts, collect); }, impl_->st);
     return out;
 }
 
+// streaming versions: nothing is allocated, each fill goes straight to the caller's sink
+uint64_t OrderBook::add_limit(Side side, int64_t px_ticks, int64_t qty, uint64_t ts, TradeSink on_trade, LimitType type) {
+    return std::visit([&](auto& st) { return st.add_limit(side, px_ticks, qty, ts, type, on_trade); }, impl_->st);
+}
+
+uint64_t OrderBook::add_market(Side side, int64_t qty, uint64_t ts, TradeSink on_trade) {
+    return std::visit([&](auto& st) { return st.add_market(side, qty, ts, on_trade); }, impl_->st);
+}
 
 bool OrderBook::cancel(uint64_t order_id) {
-    auto& st = S();
-    // look up order_id in id_to_handle; if missing -> false
-    auto hit = st.id_to_handle.find(order_id);
-    if (hit == st.id_to_handle.end()) return false;
-    
-    const Handle h = hit->second; // second references the level
-    if(h.side == Side::Buy){
-        Level& level = h.level_it->second;
-        // subtract remaining qty from aggregate
-        const int64_t removed = h.order_it->remaining_qty;
-        level.aggregate_qty -= removed;
-        // erase order node in O(1)
-        level.queue.erase(h.order_it);
-        // if level empty, erase price level
-        if(level.aggregate_qty == 0){
-            st.bids.erase(h.level_it);
-        }
-        // remove handle 
-        st.id_to_handle.erase(hit);
-        return true; 
-    } else {
-        Level& level = h.level_it->second;
-        const int64_t removed = h.order_it->remaining_qty;
-        level.aggregate_qty -= removed;
-        level.queue.erase(h.order_it);
-        if(level.aggregate_qty == 0){
-            st.asks.erase(h.level_it);
-        }
-    }
-    return true;
+    return std::visit([&](auto& st) { return st.cancel(order_id); }, impl_->st);
+}
+
+size_t OrderBook::cancel_all(std::vector<uint64_t>* cancelled) {
+    return std::visit([&](auto& st) { return st.cancel_all(cancelled); }, impl_->st);
+}
+
+size_t OrderBook::cancel_side(Side side, std::vector<uint64_t>* cancelled) {
+    return cancel_range(side, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), cancelled);
+}
+
+size_t OrderBook::cancel_range(Side side, int64_t px_lo, int64_t px_hi, std::vector<uint64_t>* cancelled) {
+    return std::visit([&](auto& st) { return st.cancel_range(side, px_lo, px_hi, cancelled); }, impl_->st);
+}
+
+size_t OrderBook::compact() {
+    return std::visit([](auto& st) { return st.compact(); }, impl_->st);
+}
+
+size_t OrderBook::shrink() {
+    return std::visit([](auto& st) { return st.shrink(); }, impl_->st);
+}
+
+AmendResult OrderBook::amend(uint64_t order_id, int64_t new_qty, int64_t new_px, uint64_t ts) {
+    AmendResult out{false, {}};
+    auto collect = [&out](const Trade& t) { out.trades.push_back(t); };
+    out.ok = std::visit([&](auto& st) { return st.amend(order_id, new_qty, new_px, ts, collect); }, impl_->st);
+    return out;
+}
+
+bool OrderBook::amend(uint64_t order_id, int64_t new_qty, int64_t new_px, uint64_t ts, TradeSink on_trade) {
+    return std::visit([&](auto& st) { return st.amend(order_id, new_qty, new_px, ts, on_trade); }, impl_->st);
+}
+
+void OrderBook::apply_batch(std::span<const Command> cmds, ResultSink& out) {
+    std::visit([&](auto& st) { st.apply_batch(cmds, out); }, impl_->st);
+}
+
+CommandAck OrderBook::dispatch(const Command& c, TradeSink on_trade) {
+    return std::visit([&](auto& st) { return st.dispatch(c, on_trade); }, impl_->st);
+}
+
+size_t OrderBook::depth(Side side, size_t n, std::span<TopOfBook> out) const {
+    return std::visit([&](const auto& st) { return st.depth(side, n, out); }, impl_->st);
+}
+
+BookStats OrderBook::stats() const {
+    return std::visit([](const auto& st) { return st.read_stats(); }, impl_->st);
+}
+
+bool OrderBook::snapshot(const std::string& path) const {
+    return std::visit([&](const auto& st) { return st.snapshot(path); }, impl_->st);
+}
+
+bool OrderBook::restore(const std::string& path) {
+    return std::visit([&](auto& st) { return st.restore(path); }, impl_->st);
+}
+
+void OrderBook::attach_journal(Journal* j) {
+    std::visit([j](auto& st) { st.journal = j; }, impl_->st);
+}
+
+void OrderBook::attach_level_sink(LevelSink sink) {
+    std::visit([&](auto& st) { st.level_sink = sink; }, impl_->st);
+}
+
+void OrderBook::detach_level_sink() {
+    std::visit([](auto& st) { st.level_sink.reset(); }, impl_->st);
 }
 
 // fn is member of OrderBook, might return TopofBook or null. const function doesn't modify object
 std::optional<TopOfBook> OrderBook::best_bid() const {
-    const auto& st = S();                       // auto = deduce the type
-    if (st.bids.empty()) return std::nullopt;
-    // std.bids.end() is iterator one past last elem in map. std::prev gives the last element in the map.
-    auto iter = std::prev(st.bids.end());         // highest price
-    const Level& level = iter->second;   // level references second, the Level object
-    return TopOfBook{iter->first, level.aggregate_qty };  // iter -> key (price)
+    return std::visit([](const auto& st) { return st.top(Side::Buy); }, impl_->st);   // highest price
 }
 
 std::optional<TopOfBook> OrderBook::best_ask() const {
-    const auto& st = S();
-    if (st.asks.empty()) return std::nullopt;
-    auto iter = st.asks.begin();                  // lowest price
-    const Level& level = iter -> second;
-    return TopOfBook{iter->first, level.aggregate_qty};
+    return std::visit([](const auto& st) { return st.top(Side::Sell); }, impl_->st);  // lowest price
 }
-// get level size, return 0 if missing
+
 int64_t OrderBook::depth_at(Side side, int64_t px_ticks) const {
-    const auto& st = S();
-    if (side == Side::Buy){
-        auto it = st.bids.find(px_ticks);
-        if(it == st.bids.end()) return 0;
-        return it->second.aggregate_qty;
-    } else {
-        auto it = st.asks.find(px_ticks);
-        return (it == st.asks.end()) ? 0 : it->second.aggregate_qty;
-    }
+    return std::visit([&](const auto& st) { return st.depth_at(side, px_ticks); }, impl_->st);
 }
 
+PoolStats OrderBook::pool_stats() const {
+    return std::visit([](const auto& st) { return st.pool_stats(); }, impl_->st);
+}
 
-AddMarketResult OrderBook::add_market(Side side, int64_t qty, uint64_t ts) {
-    AddMarketResult out{0, {}};
-    if(qty<=0) return out; // reject
-    auto& st = S();
-    // give submission temp taker id for attribution in trades
-    out.taker_order_id = st.next_id++;
-    int64_t remaining = qty;
-    if (side == Side::Buy) {
-        // from best (lowest price) outward
-        while (remaining > 0 && !st.asks.empty()) {
-            auto best_ask_it = st.asks.begin(); // lowest price
-            const int64_t level_px   = best_ask_it->first;
-            Level&        level  = best_ask_it->second;
-
-            // FIFO maker = front of the ask queue
-            auto maker_it  = level.queue.begin();
-            uint64_t maker_id = maker_it->order_id;
-
-            // fill as much as possible at this level
-            const int64_t fill = std::min(remaining, level.aggregate_qty);
-
-            // emit a trade at the maker's price (ask level price)
-            out.trades.push_back(Trade{
-                0,/*maker_order_id=*/
-                out.taker_order_id,/*taker_order_id=*/
-                level_px,/*px_ticks=*/
-                fill,/*qty=*/
-                ts/*ts=*/
-            });
-            // apply fill to remaining and level
-            maker_it->remaining_qty -= fill; // maker_it points at the FIFO front node, we subtract fill from remaining_qty, a field in the OrderNode
-            level.aggregate_qty     -= fill;
-            remaining               -= fill;
-            // if maker / order done, erase node + handle
-            if (maker_it->remaining_qty == 0) {
-                st.id_to_handle.erase(maker_id);
-                level.queue.erase(maker_it);
-            }
-
-            // if level empty then erase
-            if (level.aggregate_qty == 0) {
-                st.asks.erase(best_ask_it);
-            }
-        }
-        // market orders never rest, any leftover remaining (ie: other side ran out) goes unfilled
-        return out;
-
-    } else {
-        // Side::Sell: walk bids from best (highest price) outward
-        while (remaining > 0 && !st.bids.empty()) {
-            auto best_bid_it = std::prev(st.bids.end()); // highest price
-            const int64_t level_px  = best_bid_it->first;
-            Level&        level = best_bid_it->second;
-
-            // FIFO maker = front of the ask queue. in both bid and ask we take the most recent, from the top
-            auto maker_it  = level.queue.begin();
-            uint64_t maker_id = maker_it->order_id;
-
-            const int64_t fill = std::min(remaining, level.aggregate_qty);
-            // emit a trade at the maker's price (bid level price)
-            out.trades.push_back(Trade{
-                0,/*maker_order_id=*/
-                out.taker_order_id,/*taker_order_id=*/
-                level_px,/*px_ticks=*/
-                fill,/*qty=*/
-                ts/*ts=*/
-            });
-            // apply fill to remaining and level
-            maker_it->remaining_qty -= fill; 
-            level.aggregate_qty     -= fill;
-            remaining               -= fill;
-            // if maker / order done, erase node + handle
-            if (maker_it->remaining_qty == 0) {
-                st.id_to_handle.erase(maker_id);
-                level.queue.erase(maker_it);
-            }
-            if (level.aggregate_qty == 0){
-                st.bids.erase(best_bid_it);
-            }
-        }
-        return out;
-    }
-
-}
\ No newline at end of file
+MemoryUsage OrderBook::memory_usage() const {
+    return std::visit([](const auto& st) { return st.memory_usage(); }, impl_->st);
+}
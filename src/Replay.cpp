@@ -0,0 +1,201 @@
+// parallel multi-symbol replay: partition by symbol, work-stealing pool, deterministic merge
+#include "Replay.hpp"
+#include <algorithm>    // std::sort, std::stable_sort
+#include <deque>        // per-worker job queues
+#include <memory>
+#include <mutex>
+#include <queue>        // k-way merge heap
+#include <thread>
+
+namespace {
+
+    constexpr size_t kChunk = 4096; // commands handed to apply_batch at a time (same as Journal::replay)
+
+    // one job = one book and the indices of its events, in input order
+    struct Job {
+        uint32_t slot;
+        uint32_t symbol_id;
+        std::span<const uint64_t> events;
+    };
+
+    // what a job produces: its fills tagged with the event that caused them
+    struct JobOut {
+        std::vector<ReplayTrade> trades;
+        bool ts_sorted = true; // trades already ordered by (ts, event) -> can be merged without sorting
+    };
+
+    bool trade_before(const ReplayTrade& a, const ReplayTrade& b) {
+        return a.trade.ts != b.trade.ts ? a.trade.ts < b.trade.ts : a.event < b.event;
+    }
+
+    /**
+     * @brief Replay one book's events.
+     *
+     * Gathers the book's commands into a contiguous chunk so they go through apply_batch
+     * (and its cancel prefetching), then scatters the acks back to their event slots.
+     * acks is shared by all jobs; each job writes only its own events' entries.
+     */
+    void run_job(const Job& job, OrderBook& book, std::span<const SymbolCommand> events,
+                 CommandAck* acks, JobOut& out) {
+        std::vector<Command> cmds;
+        cmds.reserve(std::min(kChunk, job.events.size()));
+        ResultSink rs;
+        for (size_t i = 0; i < job.events.size(); i += kChunk) {
+            const size_t n = std::min(kChunk, job.events.size() - i);
+            cmds.clear();
+            for (size_t k = 0; k < n; ++k) cmds.push_back(events[job.events[i + k]].cmd);
+            rs.clear();
+            book.apply_batch(cmds, rs);
+            for (size_t k = 0; k < n; ++k) {
+                const CommandAck& a = rs.acks[k];
+                const uint64_t ev = job.events[i + k];
+                acks[ev] = CommandAck{ a.order_id, 0, a.trade_count, a.ok };
+                for (uint32_t t = a.first_trade; t < a.first_trade + a.trade_count; ++t) {
+                    const ReplayTrade rt{ ev, job.symbol_id, rs.trades[t] };
+                    if (!out.trades.empty() && trade_before(rt, out.trades.back())) out.ts_sorted = false;
+                    out.trades.push_back(rt);
+                }
+            }
+        }
+    }
+
+    /*
+     * Work stealing over a fixed job list: every job is known before the workers start and
+     * jobs never spawn jobs, so each worker gets its own deque up front, takes from its front,
+     * and when that runs dry steals from the back of the others'. Jobs are whole symbols
+     * (thousands of commands each), so one short mutex hold per job is noise - no need for a
+     * lock-free deque.
+     */
+    class JobQueues {
+    public:
+        explicit JobQueues(unsigned workers) : n_(workers), q_(std::make_unique<Queue[]>(workers)) {}
+
+        void push(unsigned w, uint32_t job) { q_[w].jobs.push_back(job); } // before the workers start
+
+        bool next(unsigned w, uint32_t& job) {
+            for (unsigned k = 0; k < n_; ++k) {
+                Queue& q = q_[(w + k) % n_];
+                std::lock_guard<std::mutex> lock(q.m);
+                if (q.jobs.empty()) continue;
+                if (k == 0) { job = q.jobs.front(); q.jobs.pop_front(); } // own queue: biggest first
+                else        { job = q.jobs.back();  q.jobs.pop_back();  } // steal: victim's smallest
+                return true;
+            }
+            return false; // nothing left anywhere: jobs never get added, so this worker is done
+        }
+
+    private:
+        struct alignas(64) Queue {   // own cache line: workers hammer only their own lock
+            std::mutex           m;
+            std::deque<uint32_t> jobs;
+        };
+        unsigned                 n_;
+        std::unique_ptr<Queue[]> q_;
+    };
+
+    // merge per-job trade lists into one (ts, event)-ordered stream. a given event's trades
+    // all live in one list, so ties between lists cannot happen and the result is unique
+    std::vector<ReplayTrade> merge(std::vector<JobOut>& outs) {
+        size_t total = 0;
+        bool all_sorted = true;
+        for (const JobOut& o : outs) { total += o.trades.size(); all_sorted &= o.ts_sorted; }
+        std::vector<ReplayTrade> merged;
+        merged.reserve(total);
+
+        if (!all_sorted) {
+            // timestamps go backwards somewhere in the input: concatenate and sort. stable, so
+            // one event's trades keep their match order
+            for (const JobOut& o : outs) merged.insert(merged.end(), o.trades.begin(), o.trades.end());
+            std::stable_sort(merged.begin(), merged.end(), trade_before);
+            return merged;
+        }
+
+        // usual case (ts non-decreasing per symbol): k-way merge, O(total * log jobs)
+        struct Cursor { const ReplayTrade* it; const ReplayTrade* end; };
+        auto later = [](const Cursor& a, const Cursor& b) { return trade_before(*b.it, *a.it); };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+        for (const JobOut& o : outs)
+            if (!o.trades.empty()) heap.push(Cursor{ o.trades.data(), o.trades.data() + o.trades.size() });
+        while (!heap.empty()) {
+            Cursor c = heap.top();
+            heap.pop();
+            merged.push_back(*c.it);
+            if (++c.it != c.end) heap.push(c);
+        }
+        return merged;
+    }
+
+} // end anonymous namespace
+
+/**
+ * @brief Replay a multi-symbol event stream, one job per book.
+ *
+ * 1) partition: counting sort of event indices by book slot (one pass to count, one to fill),
+ *    so every job's events are a contiguous, input-ordered run of one flat array
+ * 2) schedule: jobs sorted by size, biggest first, dealt round-robin to the workers' queues
+ * 3) run: workers drain their queue, then steal; each book is replayed by exactly one thread
+ * 4) merge: per-job trade lists -> one stream ordered by (ts, event)
+ * Every step is independent of which thread ran which job, so the output is too.
+ */
+ReplayResult replay(std::span<const SymbolCommand> events, BookManager& books, const ReplayOptions& opts) {
+    ReplayResult res;
+    res.acks.assign(events.size(), CommandAck{ 0, 0, 0, false });
+
+    // 1) partition. new books are added here, before any worker exists
+    std::vector<uint32_t> slot_of_event(events.size());
+    std::vector<uint64_t> count;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const uint32_t sym = events[i].symbol_id;
+        uint32_t slot = books.slot_of(sym);
+        if (slot == BookManager::kNoSlot && opts.add_symbols) {
+            books.add_symbol(sym, opts.book_options);
+            slot = books.slot_of(sym);
+        }
+        slot_of_event[i] = slot;
+        if (slot == BookManager::kNoSlot) continue; // stays rejected
+        if (slot >= count.size()) count.resize(size_t{slot} + 1, 0);
+        ++count[slot];
+    }
+    std::vector<uint64_t> start(count.size() + 1, 0);
+    for (size_t s = 0; s < count.size(); ++s) start[s + 1] = start[s] + count[s];
+    std::vector<uint64_t> order(start.back());
+    {
+        std::vector<uint64_t> fill(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < events.size(); ++i)
+            if (slot_of_event[i] != BookManager::kNoSlot) order[fill[slot_of_event[i]]++] = i;
+    }
+
+    std::vector<Job> jobs;
+    for (uint32_t s = 0; s < count.size(); ++s)
+        if (count[s]) jobs.push_back(Job{ s, books.symbol_at(s), std::span<const uint64_t>(order.data() + start[s], count[s]) });
+    std::vector<JobOut> outs(jobs.size());
+
+    // 2) + 3) schedule and run
+    unsigned workers = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned>(std::min<size_t>(workers, jobs.size()));
+    if (workers <= 1) {
+        for (size_t j = 0; j < jobs.size(); ++j) run_job(jobs[j], books.book_at(jobs[j].slot), events, res.acks.data(), outs[j]);
+    } else {
+        std::vector<uint32_t> by_size(jobs.size());
+        for (uint32_t j = 0; j < by_size.size(); ++j) by_size[j] = j;
+        std::sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b) {
+            return jobs[a].events.size() != jobs[b].events.size() ? jobs[a].events.size() > jobs[b].events.size() : a < b;
+        });
+        JobQueues queues(workers);
+        for (size_t k = 0; k < by_size.size(); ++k) queues.push(static_cast<unsigned>(k % workers), by_size[k]);
+
+        std::vector<std::thread> pool;
+        pool.reserve(workers);
+        for (unsigned w = 0; w < workers; ++w) {
+            pool.emplace_back([&, w] {
+                uint32_t j;
+                while (queues.next(w, j)) run_job(jobs[j], books.book_at(jobs[j].slot), events, res.acks.data(), outs[j]);
+            });
+        }
+        for (std::thread& t : pool) t.join();
+    }
+
+    // 4) merge
+    res.trades = merge(outs);
+    return res;
+}
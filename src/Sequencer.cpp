@@ -0,0 +1,123 @@
+// the matching thread: drain producer rings round-robin, match, push reports back
+#include "Sequencer.hpp"
+#ifdef __linux__
+#include <pthread.h>    // pthread_setaffinity_np
+#include <sched.h>      // cpu_set_t
+#endif
+
+namespace {
+
+    // tell the core we are spinning (frees pipeline resources for the sibling hyperthread)
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // spin on an empty pass for a while before giving the core back: a busy matcher never
+    // reaches the yield, an idle one does not burn a whole cpu forever
+    constexpr unsigned kSpinsBeforeYield = 1024;
+
+    void pin_to_cpu([[maybe_unused]] std::thread& t, [[maybe_unused]] int cpu) {
+#ifdef __linux__
+        if (cpu < 0) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        // best effort: an invalid cpu just leaves the thread unpinned
+        pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#endif
+    }
+
+} // end anonymous namespace
+
+Sequencer::Sequencer(BookManager& books, const SequencerOptions& opts)
+    : books_(books), opts_(opts) {
+    if (opts_.burst == 0) opts_.burst = 1;
+}
+
+Sequencer::~Sequencer() { stop(); }
+
+Sequencer::Producer& Sequencer::add_producer() {
+    producers_.push_back(std::unique_ptr<Producer>(new Producer(opts_.command_ring, opts_.report_ring)));
+    return *producers_.back();
+}
+
+bool Sequencer::start() {
+    if (running_.exchange(true)) return false;
+    thread_ = std::thread([this] { run(); });
+    pin_to_cpu(thread_, opts_.cpu);
+    return true;
+}
+
+void Sequencer::stop() {
+    running_.store(false, std::memory_order_release);
+    if (thread_.joinable()) thread_.join();
+}
+
+/**
+ * @brief Matching loop.
+ *
+ * Visits producers round-robin, taking up to opts_.burst commands from each so one busy
+ * gateway cannot starve the rest. Sequence numbers are handed out in the order commands
+ * are taken, so they are a total order over everything the engine did.
+ * After stop() the loop keeps going until one full pass finds every ring empty.
+ */
+void Sequencer::run() {
+    unsigned idle = 0;
+    SymbolCommand sc;
+    for (;;) {
+        // read the flag before the pass: if it is already down and the pass finds nothing,
+        // every command submitted before stop() has been handled
+        const bool stopping = !running_.load(std::memory_order_acquire);
+        bool did_work = false;
+        for (auto& p : producers_) {
+            for (uint32_t n = 0; n < opts_.burst && p->in_.try_pop(sc); ++n) {
+                process(*p, sc);
+                did_work = true;
+            }
+        }
+        if (did_work) { idle = 0; continue; }
+        if (stopping) return;
+        if (++idle < kSpinsBeforeYield) cpu_relax();
+        else std::this_thread::yield();
+    }
+}
+
+void Sequencer::process(Producer& p, const SymbolCommand& sc) {
+    Report ack{};
+    ack.seq       = seq_.load(std::memory_order_relaxed) + 1;
+    ack.symbol_id = sc.symbol_id;
+    ack.type      = ReportType::Ack;
+    ack.ack       = CommandAck{ 0, 0, 0, false };
+    seq_.store(ack.seq, std::memory_order_relaxed);
+
+    OrderBook* book = books_.find(sc.symbol_id);
+    if (book) {
+        // fills go straight from the matcher into the producer's report ring
+        Report tr{};
+        tr.seq       = ack.seq;
+        tr.symbol_id = sc.symbol_id;
+        tr.type      = ReportType::Trade;
+        uint32_t trades = 0;
+        auto on_trade = [&](const Trade& t) {
+            tr.trade = t;
+            emit(p, tr);
+            ++trades;
+        };
+        ack.ack = book->dispatch(sc.cmd, on_trade);
+        ack.ack.trade_count = trades;
+    }
+    emit(p, ack);
+}
+
+// a full report ring is backpressure: the matcher waits for that gateway to catch up
+// (dropping reports is never an option). a producer that stops polling stalls the engine
+void Sequencer::emit(Producer& p, const Report& r) {
+    for (unsigned spins = 0; !p.out_.try_push(r); ++spins) {
+        if (spins < kSpinsBeforeYield) cpu_relax();
+        else std::this_thread::yield();
+    }
+}
@@ -0,0 +1,96 @@
+// hot-path instrumentation behind OrderBook::stats()
+// compiled in only with -DMINIEX_STATS=1 (cmake -DMINIEX_STATS=ON); otherwise every hook
+// below is an `if constexpr (kStats)` that the compiler drops, so the matcher pays nothing
+#pragma once
+
+#include "OrderBook.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>        // std::bit_width -> power-of-two bucket
+#include <chrono>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#endif
+
+namespace detail {
+
+#if defined(MINIEX_STATS) && MINIEX_STATS
+    inline constexpr bool kStats = true;
+#else
+    inline constexpr bool kStats = false;
+#endif
+
+    /// cheapest monotonic-ish tick counter on this cpu (TSC on x86, the virtual counter on arm64)
+    inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t v;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+        return v;
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    /**
+     * @brief Counter with exactly one writer (the matching thread) and any number of readers.
+     *
+     * The writer does a relaxed load + relaxed store instead of fetch_add, so there is no
+     * locked instruction on the hot path; readers never block the writer and see a value
+     * that is at most a few updates stale.
+     */
+    class Counter {
+    public:
+        void     add(uint64_t n = 1)  { v_.store(v_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+        void     sub(uint64_t n = 1)  { v_.store(v_.load(std::memory_order_relaxed) - n, std::memory_order_relaxed); }
+        void     set(uint64_t n)      { v_.store(n, std::memory_order_relaxed); }
+        void     max(uint64_t n)      { if (n > get()) set(n); }
+        uint64_t get() const          { return v_.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<uint64_t> v_{0};
+    };
+
+    struct LatencyCounters {
+        Counter buckets[kLatencyBuckets];  ///< bucket i counts ops that took [2^(i-1), 2^i) ticks
+
+        void record(uint64_t ticks) {
+            buckets[std::min<size_t>(std::bit_width(ticks), kLatencyBuckets - 1)].add();
+        }
+        void read(LatencyHistogram& out) const {
+            out.count = 0;
+            for (size_t i = 0; i < kLatencyBuckets; ++i) { out.buckets[i] = buckets[i].get(); out.count += out.buckets[i]; }
+        }
+    };
+
+    /// everything stats() reports; heap-allocated once per book so its address never changes
+    struct EngineStats {
+        LatencyCounters add_limit, add_market, cancel, amend;
+        Counter aggressive_orders;   ///< orders that traded against at least one maker
+        Counter levels_touched;      ///< sum over aggressive orders
+        Counter max_levels_touched;
+        Counter trades;
+        Counter max_trades;          ///< most trades emitted by a single order
+        Counter cancel_hits, cancel_misses;
+        Counter resting_orders, bid_levels, ask_levels;
+    };
+
+    /// times one operation into one of the EngineStats histograms; an empty no-op when
+    /// stats are compiled out (the EngineStats pointer is then null and never touched)
+    template <bool On = kStats>
+    struct OpTimer {
+        OpTimer(EngineStats*, LatencyCounters EngineStats::*) {}
+    };
+    template <>
+    struct OpTimer<true> {
+        OpTimer(EngineStats* s, LatencyCounters EngineStats::* which) : h_(s->*which), t0_(cycles()) {}
+        ~OpTimer() { h_.record(cycles() - t0_); }
+        OpTimer(const OpTimer&) = delete;
+        OpTimer& operator=(const OpTimer&) = delete;
+    private:
+        LatencyCounters& h_;
+        uint64_t         t0_;
+    };
+
+} // namespace detail
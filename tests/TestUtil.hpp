@@ -0,0 +1,18 @@
+// helpers shared by the test drivers (header-only, each test is a single translation unit)
+#pragma once
+
+#include "OrderBook.hpp"
+#include <cstdint>
+
+// seeded 64-bit LCG (Knuth's MMIX constants), high bits out. the same seed gives the same flow
+// on every platform and standard library, which std::rand and the <random> distributions don't
+struct Lcg {
+    uint64_t x;
+    uint64_t operator()() { x = x * 6364136223846793005ULL + 1442695040888963407ULL; return x >> 33; }
+};
+
+// run body(store) once per level ladder, so one copy of a test checks both
+template <class Body>
+void for_each_store(Body&& body) {
+    for (LevelStore store : { LevelStore::Map, LevelStore::Dense }) body(store);
+}
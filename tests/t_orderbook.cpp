@@ -1,7 +1,25 @@
 // if an assert fails, the program aborts w a non-zero exit code, makes the build red
 
 #include "OrderBook.hpp"   // the public api we defined
+#include "BookManager.hpp" // one book per symbol
+#include "TestUtil.hpp"    // seeded generator, both-ladder loop
+#include <algorithm>       // std::max, std::sort, std::find
 #include <cassert>         // assert() for simple checks. if any fails, test exits w/ nonzero
+#include <cstdlib>         // malloc/free for the counting operator new
+#include <limits>
+#include <new>
+#include <vector>
+
+// count heap allocations so tests can check the streaming paths really allocate nothing.
+// kept out of line: inlined, gcc pairs malloc/free against new/delete and warns -Wmismatched-new-delete
+static size_t g_allocs = 0;
+[[gnu::noinline]] void* operator new(size_t n) {
+    ++g_allocs;
+    if (void* p = std::malloc(n)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { std::free(p); }
 
 int main() {
     OrderBook ob;
@@ -120,6 +138,687 @@ int main() {
     assert(ob.cancel(rS.taker_order_id) == false);
 
 
+    // --- T4: separate books never share state ---
+    // Given: two fresh books; resting bid only in the first
+    OrderBook a, b;
+    auto ra = a.add_limit(Side::Buy, /*px=*/10, /*qty=*/5, /*ts=*/1);
+    assert(ra.order_id != 0);
+    // Then: the second book sees nothing, and a crossing sell there does not trade against book a
+    assert(!b.best_bid().has_value());
+    auto rb = b.add_limit(Side::Sell, /*px=*/10, /*qty=*/5, /*ts=*/2);
+    assert(rb.trades.empty());
+    assert(a.depth_at(Side::Buy, 10) == 5);
+    assert(b.depth_at(Side::Sell, 10) == 5);
+
+    // --- T5: BookManager routes by symbol id ---
+    BookManager mgr(/*expected_symbols=*/4);
+    OrderBook& s7 = mgr.add_symbol(7);
+    mgr.add_symbol(3);
+    assert(mgr.size() == 2);
+    assert(&mgr.add_symbol(7) == &s7);       // re-adding returns the same book
+    assert(mgr.find(7) == &s7);
+    assert(mgr.find(5) == nullptr);          // never added (inside table range)
+    assert(mgr.find(1000) == nullptr);       // never added (past table range)
+    s7.add_limit(Side::Sell, /*px=*/20, /*qty=*/1, /*ts=*/1);
+    assert(mgr.find(7)->best_ask().has_value());
+    assert(!mgr.find(3)->best_ask().has_value());
+    assert(mgr.symbol_at(0) == 7 && mgr.symbol_at(1) == 3);
+    // far past expected_symbols: books already handed out do not move
+    for (uint32_t sym = 100; sym < 1100; ++sym) mgr.add_symbol(sym);
+    assert(mgr.find(7) == &s7 && s7.best_ask()->px_ticks == 20);
+
+    // --- T6: dense ladder re-centers and falls back to the sparse map ---
+    // small 64-tick window so prices land outside it
+    OrderBook d(BookOptions{ LevelStore::Dense, /*dense_window_ticks=*/64 });
+    auto d1 = d.add_limit(Side::Buy, /*px=*/1000, /*qty=*/1, /*ts=*/1);  // first level: window centers on 1000
+    d.add_limit(Side::Buy, /*px=*/990, /*qty=*/2, /*ts=*/2);            // inside the window
+    d.add_limit(Side::Buy, /*px=*/10,  /*qty=*/3, /*ts=*/3);            // far below -> sparse fallback
+    assert(d.best_bid()->px_ticks == 1000);
+    assert(d.depth_at(Side::Buy, 10) == 3);
+    // touch drifts past the window's top edge -> window moves, old levels spill to the sparse map
+    auto d4 = d.add_limit(Side::Buy, /*px=*/2000, /*qty=*/4, /*ts=*/4);
+    assert(d.best_bid()->px_ticks == 2000 && d.best_bid()->agg_qty == 4);
+    assert(d.depth_at(Side::Buy, 990) == 2);
+    // window drains -> it re-centers over the best remaining far level
+    assert(d.cancel(d4.order_id));
+    assert(d.best_bid()->px_ticks == 1000);
+    assert(d.cancel(d1.order_id));
+    assert(d.best_bid()->px_ticks == 990);
+    // crossing sell sweeps 990 then stops above 10
+    auto ds = d.add_limit(Side::Sell, /*px=*/500, /*qty=*/5, /*ts=*/5);
+    assert(ds.trades.size() == 1 && ds.trades[0].px_ticks == 990 && ds.trades[0].qty == 2);
+    assert(d.best_ask()->px_ticks == 500 && d.best_ask()->agg_qty == 3);
+    assert(d.best_bid()->px_ticks == 10);
+
+    // --- T6b: dense window at the very top of the price range (no offset overflow) ---
+    {
+        constexpr int64_t kTop = std::numeric_limits<int64_t>::max();
+        OrderBook e(BookOptions{ LevelStore::Dense, /*dense_window_ticks=*/64 });
+        e.add_limit(Side::Sell, kTop, 1, 1);
+        e.add_limit(Side::Sell, kTop - 1, 2, 2);
+        e.add_limit(Side::Sell, kTop - 70, 3, 3);      // window moves down onto it
+        assert(e.best_ask()->px_ticks == kTop - 70 && e.depth_at(Side::Sell, kTop) == 1);
+        auto eb = e.add_limit(Side::Buy, kTop - 5, 4, 4);
+        assert(eb.trades.size() == 1 && eb.trades[0].px_ticks == kTop - 70);
+        assert(e.best_bid()->px_ticks == kTop - 5 && e.best_ask()->px_ticks == kTop - 1);
+        auto em = e.add_market(Side::Buy, 3, 5);
+        assert(em.trades.size() == 2 && em.trades[1].px_ticks == kTop && !e.best_ask());
+        assert(e.cancel(eb.order_id));
+        const uint64_t top_bid = e.add_limit(Side::Buy, kTop, 1, 6).order_id;
+        e.add_limit(Side::Buy, 0, 1, 7);
+        e.add_limit(Side::Buy, kTop - 63, 1, 8);
+        assert(e.best_bid()->px_ticks == kTop && e.depth_at(Side::Buy, kTop - 63) == 1);
+        assert(e.cancel(top_bid) && e.best_bid()->px_ticks == kTop - 63);
+        TopOfBook lv[4];
+        assert(e.depth(Side::Buy, 4, lv) == 2 && lv[1].px_ticks == 0);
+    }
+
+    // --- T7: map and dense books agree on the same flow ---
+    OrderBook m_book;
+    OrderBook d_book(BookOptions{ LevelStore::Dense, /*dense_window_ticks=*/128 });
+    std::vector<uint64_t> m_ids, d_ids;
+    Lcg next{ 12345 };
+    for (uint64_t ts = 1; ts <= 5000; ++ts) {
+        const uint64_t op = next() % 10;
+        const int64_t  px = 1000 + static_cast<int64_t>(next() % 400) - 200; // wider than the window
+        const int64_t  q  = 1 + static_cast<int64_t>(next() % 5);
+        if (op < 4) {
+            m_ids.push_back(m_book.add_limit(Side::Buy, px, q, ts).order_id);
+            d_ids.push_back(d_book.add_limit(Side::Buy, px, q, ts).order_id);
+        } else if (op < 7) {
+            auto mr = m_book.add_limit(Side::Sell, px + 150, q, ts);
+            auto dr = d_book.add_limit(Side::Sell, px + 150, q, ts);
+            assert(mr.trades.size() == dr.trades.size());
+            m_ids.push_back(mr.order_id);
+            d_ids.push_back(dr.order_id);
+        } else if (op < 9 && !m_ids.empty()) {
+            const size_t k = next() % m_ids.size();
+            assert(m_book.cancel(m_ids[k]) == d_book.cancel(d_ids[k]));
+        } else {
+            auto mr = m_book.add_market(op % 2 ? Side::Buy : Side::Sell, q, ts);
+            auto dr = d_book.add_market(op % 2 ? Side::Buy : Side::Sell, q, ts);
+            assert(mr.trades.size() == dr.trades.size());
+        }
+        auto mb = m_book.best_bid(), db = d_book.best_bid();
+        auto ma = m_book.best_ask(), da = d_book.best_ask();
+        assert(mb.has_value() == db.has_value() && (!mb || (mb->px_ticks == db->px_ticks && mb->agg_qty == db->agg_qty)));
+        assert(ma.has_value() == da.has_value() && (!ma || (ma->px_ticks == da->px_ticks && ma->agg_qty == da->agg_qty)));
+        assert(m_book.depth_at(Side::Buy, px) == d_book.depth_at(Side::Buy, px));
+    }
+
+    // --- T8: order-node pool recycles slots; a sized pool never grows ---
+    BookOptions pooled;
+    pooled.order_capacity = 8;   // 8 resting; the book adds the slot a taker holds for its id
+    OrderBook p(pooled);
+    assert(p.pool_stats().capacity == 9 && p.pool_stats().live == 0);
+    for (uint64_t round = 0; round < 100; ++round) {
+        std::vector<uint64_t> ids;
+        for (int64_t i = 0; i < 8; ++i) ids.push_back(p.add_limit(Side::Buy, /*px=*/100 + i % 3, /*qty=*/1, round).order_id);
+        // FIFO inside a level survives the intrusive links: oldest at 100 fills first
+        auto fill = p.add_market(Side::Sell, /*qty=*/1, round);
+        assert(fill.trades.size() == 1 && fill.trades[0].maker_order_id == ids[2]); // 102 is best, ids[2] is oldest there
+        // back to 8 resting: limit takers that never rest borrow the same spare slot
+        ids.push_back(p.add_limit(Side::Buy, /*px=*/99, /*qty=*/1, round).order_id);
+        assert(p.add_limit(Side::Sell, /*px=*/102, /*qty=*/1, round).trades.size() == 1);
+        assert(p.add_limit(Side::Sell, /*px=*/101, /*qty=*/1, round, LimitType::IOC).trades.size() == 1);
+        for (uint64_t id : ids) p.cancel(id);
+    }
+    auto ps = p.pool_stats();
+    assert(ps.live == 0);
+    assert(ps.capacity == 9);       // filled/cancelled slots were reused, never reallocated
+    assert(ps.high_water == 9);
+
+    // --- T9: ids of filled / cancelled orders go stale even though their slot is reused ---
+    OrderBook g;
+    auto g1 = g.add_limit(Side::Buy, /*px=*/50, /*qty=*/1, /*ts=*/1);
+    assert(g.cancel(g1.order_id));
+    auto g2 = g.add_limit(Side::Buy, /*px=*/50, /*qty=*/1, /*ts=*/2);   // reuses g1's slot
+    assert(g2.order_id != g1.order_id);
+    assert(g.cancel(g1.order_id) == false);   // stale generation
+    assert(g.depth_at(Side::Buy, 50) == 1);   // ...and did not touch the live order
+    assert(g.cancel(0) == false);
+    assert(g.cancel(0xFFFFFFFFFFFFull) == false); // slot past the end of the table
+    assert(g.cancel(g2.order_id));
+
+    // --- T10: trades stream into a caller-owned buffer with no allocation ---
+    OrderBook sk;
+    auto maker = sk.add_limit(Side::Buy, /*px=*/100, /*qty=*/1000, /*ts=*/1);
+    Trade  buf[4];
+    size_t n_buf = 0;
+    auto into_buf = [&](const Trade& t) { buf[n_buf++ % 4] = t; };
+    // warm up (first taker slot), then check steady-state crossing sells allocate nothing
+    sk.add_limit(Side::Sell, /*px=*/100, /*qty=*/1, /*ts=*/2, into_buf);
+    const size_t allocs_before = g_allocs;
+    for (uint64_t ts = 3; ts < 103; ++ts) {
+        const uint64_t id = sk.add_limit(Side::Sell, /*px=*/100, /*qty=*/2, ts, into_buf);
+        assert(id != 0);
+    }
+    for (uint64_t ts = 103; ts < 203; ++ts) sk.add_market(Side::Sell, /*qty=*/1, ts, into_buf);
+    assert(g_allocs == allocs_before);
+    assert(n_buf == 1 + 100 + 100);
+    assert(buf[(n_buf - 1) % 4].maker_order_id == maker.order_id && buf[(n_buf - 1) % 4].qty == 1);
+    assert(sk.depth_at(Side::Buy, 100) == 1000 - 1 - 200 - 100);
+    // rejected on the streaming path: id 0 and the sink is never called
+    assert(sk.add_market(Side::Buy, /*qty=*/0, /*ts=*/300, into_buf) == 0);
+    assert(n_buf == 201);
+
+    // --- T11: apply_batch == the same commands one call at a time ---
+    OrderBook one, bat;
+    std::vector<Command> cmds;
+    cmds.push_back(Command{ CommandType::AddLimit,  Side::Buy,  /*px=*/10, /*qty=*/5, /*ts=*/1, 0 });
+    cmds.push_back(Command{ CommandType::AddLimit,  Side::Buy,  /*px=*/11, /*qty=*/2, /*ts=*/2, 0 });
+    cmds.push_back(Command{ CommandType::AddLimit,  Side::Sell, /*px=*/10, /*qty=*/4, /*ts=*/3, 0 }); // crosses 11 then 10
+    cmds.push_back(Command{ CommandType::AddMarket, Side::Sell, 0,         /*qty=*/1, /*ts=*/4, 0 });
+    cmds.push_back(Command{ CommandType::AddLimit,  Side::Sell, /*px=*/20, /*qty=*/0, /*ts=*/5, 0 }); // rejected
+    std::vector<uint64_t> one_ids;
+    std::vector<Trade>    one_trades;
+    for (const Command& c : cmds) {
+        if (c.type == CommandType::AddLimit) {
+            auto r = one.add_limit(c.side, c.px_ticks, c.qty, c.ts);
+            one_ids.push_back(r.order_id);
+            one_trades.insert(one_trades.end(), r.trades.begin(), r.trades.end());
+        } else {
+            auto r = one.add_market(c.side, c.qty, c.ts);
+            one_ids.push_back(r.taker_order_id);
+            one_trades.insert(one_trades.end(), r.trades.begin(), r.trades.end());
+        }
+    }
+    // cancel the first bid in both (id is the same: both books saw the same flow)
+    cmds.push_back(Command{ CommandType::Cancel, Side::Buy, 0, 0, 0, one_ids[0] });
+    cmds.push_back(Command{ CommandType::Cancel, Side::Buy, 0, 0, 0, one_ids[0] }); // second time: miss
+    assert(one.cancel(one_ids[0]));
+    ResultSink rs;
+    bat.apply_batch(cmds, rs);
+    assert(rs.acks.size() == cmds.size());
+    for (size_t i = 0; i < one_ids.size(); ++i) assert(rs.acks[i].order_id == one_ids[i]);
+    assert(rs.acks[2].trade_count == 2 && rs.acks[2].first_trade == 0);
+    assert(rs.acks[3].trade_count == 1 && rs.acks[3].first_trade == 2);
+    assert(!rs.acks[4].ok);
+    assert(rs.acks[5].ok && !rs.acks[6].ok);
+    assert(rs.trades.size() == one_trades.size());
+    for (size_t i = 0; i < one_trades.size(); ++i)
+        assert(rs.trades[i].maker_order_id == one_trades[i].maker_order_id && rs.trades[i].qty == one_trades[i].qty);
+    assert(!bat.best_bid().has_value() && !one.best_bid().has_value());
+    // dispatch() one command at a time: the same acks, trade placement left to the caller
+    OrderBook dis;
+    size_t dis_fills = 0;
+    auto count_fills = [&dis_fills](const Trade&) { ++dis_fills; };
+    for (size_t i = 0; i < cmds.size(); ++i) {
+        const CommandAck a = dis.dispatch(cmds[i], count_fills);
+        assert(a.order_id == rs.acks[i].order_id && a.ok == rs.acks[i].ok && a.trade_count == 0);
+    }
+    assert(dis_fills == rs.trades.size());
+    // reusing a cleared sink keeps its capacity
+    const size_t cap = rs.trades.capacity();
+    rs.clear();
+    assert(rs.trades.empty() && rs.trades.capacity() == cap);
+
+    // --- T12: stats() -- gauges always, counters only when built with MINIEX_STATS ---
+    for_each_store([&](LevelStore store) {
+        OrderBook ob(BookOptions{ store });
+        ob.add_limit(Side::Buy, 10, 5, 1);
+        ob.add_limit(Side::Buy, 11, 5, 2);
+        ob.add_limit(Side::Buy, 11, 5, 3);
+        const uint64_t ask = ob.add_limit(Side::Sell, 20, 5, 4).order_id;
+        ob.add_limit(Side::Sell, 10, 12, 5);   // 5 @11, 5 @11, 2 @10: two levels, three trades
+        assert(ob.cancel(ask));
+        assert(!ob.cancel(ask));               // miss
+        ob.add_market(Side::Sell, 1, 6);
+
+        BookStats s = ob.stats();
+        assert(s.resting_orders == 1);         // 2 left @10
+        assert(s.bid_levels == 1 && s.ask_levels == 0);
+        if (s.enabled) {
+            assert(s.aggressive_orders == 2);
+            assert(s.trades == 4 && s.max_trades == 3);
+            assert(s.levels_touched == 3 && s.max_levels_touched == 2);
+            assert(s.cancel_hits == 1 && s.cancel_misses == 1);
+            assert(s.add_limit.count == 5 && s.add_market.count == 1 && s.cancel.count == 2);
+        } else {
+            assert(s.add_limit.count == 0 && s.trades == 0);
+        }
+    });
+
+    // --- T13: L2 deltas - one coalesced batch per command, gap-free seq ---
+    for_each_store([&](LevelStore store) {
+        OrderBook ob(BookOptions{ store });
+        std::vector<std::vector<LevelUpdate>> batches;
+        auto on_levels = [&](std::span<const LevelUpdate> u) { batches.emplace_back(u.begin(), u.end()); };
+        ob.attach_level_sink(on_levels);
+
+        ob.add_limit(Side::Buy, 10, 5, 1);
+        ob.add_limit(Side::Buy, 10, 3, 2);
+        ob.add_limit(Side::Buy, 11, 4, 3);
+        ob.add_limit(Side::Buy, 12, 2, 4);
+        assert(batches.size() == 4);
+        assert(batches[1].size() == 1 && batches[1][0].side == Side::Buy && batches[1][0].px_ticks == 10 && batches[1][0].agg_qty == 8);
+
+        // sell 10 @10: fills 2 @12, 4 @11, 4 of the 8 @10 -> one batch, one entry per level
+        batches.clear();
+        auto r = ob.add_limit(Side::Sell, 10, 10, 5);
+        assert(r.trades.size() == 3);
+        assert(batches.size() == 1 && batches[0].size() == 3);
+        assert(batches[0][0].px_ticks == 12 && batches[0][0].agg_qty == 0);
+        assert(batches[0][1].px_ticks == 11 && batches[0][1].agg_qty == 0);
+        assert(batches[0][2].px_ticks == 10 && batches[0][2].agg_qty == 4);
+        assert(batches[0][0].seq == 5 && batches[0][1].seq == 6 && batches[0][2].seq == 7);
+
+        // sweep leaves a remainder that rests on the other side: both levels in the same batch
+        batches.clear();
+        ob.add_limit(Side::Sell, 9, 6, 6);
+        assert(batches.size() == 1 && batches[0].size() == 2);
+        assert(batches[0][0].side == Side::Buy  && batches[0][0].px_ticks == 10 && batches[0][0].agg_qty == 0);
+        assert(batches[0][1].side == Side::Sell && batches[0][1].px_ticks == 9  && batches[0][1].agg_qty == 2);
+        const uint64_t ask = ob.add_limit(Side::Sell, 15, 1, 7).order_id;
+
+        // rejected / no-op commands publish nothing; cancel publishes its level
+        batches.clear();
+        ob.add_limit(Side::Buy, 10, 0, 8);
+        ob.add_market(Side::Sell, 1, 9); // no bids left
+        assert(!ob.cancel(12345));
+        assert(batches.empty());
+        assert(ob.cancel(ask));
+        assert(batches.size() == 1 && batches[0].size() == 1 && batches[0][0].agg_qty == 0 && batches[0][0].seq == 11);
+
+        // batch path publishes per command too; detaching stops the feed
+        batches.clear();
+        std::vector<Command> cmds = { Command{ CommandType::AddLimit, Side::Sell, 20, 1, 10, 0 },
+                                      Command{ CommandType::AddMarket, Side::Buy, 0, 3, 11, 0 } };
+        ResultSink rs;
+        ob.apply_batch(cmds, rs);
+        assert(batches.size() == 2 && batches[1].size() == 2); // market buy took 9 and 20
+        ob.detach_level_sink();
+        ob.add_limit(Side::Buy, 5, 1, 12);
+        assert(batches.size() == 2);
+    });
+
+    // --- T14: depth(n) == a brute-force scan, through random flow that keeps reshaping the top ---
+    for_each_store([&](LevelStore store) {
+        OrderBook ob(BookOptions{ store, /*dense_window_ticks=*/64 });
+        Lcg next{ 99 };
+        std::vector<uint64_t> ids;
+        TopOfBook got[64], want[64];
+        auto brute = [&](Side side, size_t n) {
+            size_t k = 0;
+            for (int64_t i = 0; i <= 400 && k < n; ++i) {
+                const int64_t px = side == Side::Buy ? 400 - i : i;
+                if (const int64_t q = ob.depth_at(side, px)) want[k++] = TopOfBook{ px, q };
+            }
+            return k;
+        };
+        for (int step = 0; step < 20000; ++step) {
+            const uint64_t k = next() % 10;
+            const Side side = next() & 1 ? Side::Buy : Side::Sell;
+            if (k < 3 && !ids.empty()) {
+                ob.cancel(ids[next() % ids.size()]);
+            } else if (k < 4) {
+                ob.add_market(side, 1 + int64_t(next() % 20), step);
+            } else {
+                const int64_t px = side == Side::Buy ? 100 + int64_t(next() % 120) : 180 + int64_t(next() % 120);
+                ids.push_back(ob.add_limit(side, px, 1 + int64_t(next() % 9), step).order_id);
+            }
+            const size_t n = std::initializer_list<size_t>{ 1, 5, 10, 50, 64 }.begin()[next() % 5];
+            for (Side s : { Side::Buy, Side::Sell }) {
+                const size_t c = ob.depth(s, n, got);
+                assert(c == brute(s, n));
+                for (size_t i = 0; i < c; ++i) assert(got[i].px_ticks == want[i].px_ticks && got[i].agg_qty == want[i].agg_qty);
+                // asking again without a change is served from the cache and must agree
+                assert(ob.depth(s, n, got) == c);
+            }
+        }
+        // out smaller than n caps the copy
+        TopOfBook two[2];
+        assert(ob.depth(Side::Sell, 10, two) <= 2);
+    });
+
+    // --- T15: amend - qty down keeps FIFO priority, qty up / new price re-queues under the same id ---
+    for_each_store([&](LevelStore store) {
+        OrderBook ob(BookOptions{ store });
+        const uint64_t a = ob.add_limit(Side::Buy, 10, 5, 1).order_id;
+        const uint64_t b = ob.add_limit(Side::Buy, 10, 4, 2).order_id;
+        const uint64_t c = ob.add_limit(Side::Buy, 9, 3, 3).order_id;
+        const size_t slots = ob.pool_stats().capacity;
+
+        // qty down: level shrinks, a still fills first
+        assert(ob.amend(a, 2, 10, 4).ok);
+        assert(ob.depth_at(Side::Buy, 10) == 6);
+        auto m1 = ob.add_market(Side::Sell, 1, 5);
+        assert(m1.trades.size() == 1 && m1.trades[0].maker_order_id == a);
+
+        // qty up at the same price: a goes behind b
+        assert(ob.amend(a, 3, 10, 6).ok);
+        assert(ob.depth_at(Side::Buy, 10) == 7);
+        auto m2 = ob.add_market(Side::Sell, 5, 7);
+        assert(m2.trades.size() == 2 && m2.trades[0].maker_order_id == b && m2.trades[0].qty == 4);
+        assert(m2.trades[1].maker_order_id == a && m2.trades[1].qty == 1);
+
+        // new price: a leaves 10 (level dropped) and joins the tail of 9 behind c
+        assert(ob.amend(a, 2, 9, 8).ok);
+        assert(ob.depth_at(Side::Buy, 10) == 0 && ob.depth_at(Side::Buy, 9) == 5);
+        assert(ob.best_bid()->px_ticks == 9);
+        auto m3 = ob.add_market(Side::Sell, 4, 9);
+        assert(m3.trades.size() == 2 && m3.trades[0].maker_order_id == c && m3.trades[1].maker_order_id == a);
+        assert(ob.depth_at(Side::Buy, 9) == 1);
+
+        // re-priced sell that crosses: trades as a taker with its own id, the rest keeps resting
+        const uint64_t s1 = ob.add_limit(Side::Sell, 20, 3, 10).order_id;
+        auto cr = ob.amend(s1, 3, 9, 11);
+        assert(cr.ok && cr.trades.size() == 1 && cr.trades[0].taker_order_id == s1 && cr.trades[0].qty == 1);
+        assert(!ob.best_bid() && ob.depth_at(Side::Sell, 20) == 0 && ob.depth_at(Side::Sell, 9) == 2);
+        assert(ob.amend(s1, 1, 9, 12).ok);   // id still live after the move
+        assert(ob.depth_at(Side::Sell, 9) == 1);
+
+        // rejects leave the book alone
+        assert(!ob.amend(s1, 0, 9, 13).ok);
+        assert(!ob.amend(s1, 1, -1, 13).ok);
+        assert(!ob.amend(a, 1, 9, 13).ok);   // a filled above: stale id
+        assert(!ob.amend(0, 1, 9, 13).ok);
+        assert(ob.depth_at(Side::Sell, 9) == 1);
+
+        // the node is relinked, never re-allocated
+        assert(ob.pool_stats().capacity == slots);
+        const size_t allocs_before = g_allocs;
+        auto sink = [](const Trade&) {};
+        assert(ob.amend(s1, 1, 15, 14, sink));
+        if (store == LevelStore::Dense) assert(g_allocs == allocs_before); // (a Map ladder allocates a tree node per new price)
+    });
+
+    // --- T16: buys cross like sells do; the book behaves the same seen through a price mirror ---
+    {
+        OrderBook ob;
+        const uint64_t a1 = ob.add_limit(Side::Sell, 12, 2, 1).order_id;
+        const uint64_t a2 = ob.add_limit(Side::Sell, 13, 2, 2).order_id;
+        auto r = ob.add_limit(Side::Buy, 13, 5, 3);
+        assert(r.trades.size() == 2);
+        assert(r.trades[0].maker_order_id == a1 && r.trades[0].px_ticks == 12);
+        assert(r.trades[1].maker_order_id == a2 && r.trades[1].px_ticks == 13);
+        assert(!ob.best_ask() && ob.best_bid()->px_ticks == 13 && ob.best_bid()->agg_qty == 1);
+        // a buy below the best ask does not cross
+        ob.add_limit(Side::Sell, 20, 1, 4);
+        assert(ob.add_limit(Side::Buy, 19, 1, 5).trades.empty());
+    }
+    for_each_store([&](LevelStore store) {
+        // every command is mirrored (side swapped, px -> 1000 - px): trades must match one for one
+        OrderBook ob(BookOptions{ store, /*dense_window_ticks=*/128 }), mirror(BookOptions{ store, /*dense_window_ticks=*/128 });
+        Lcg next{ 5 };
+        auto flip = [](Side s) { return s == Side::Buy ? Side::Sell : Side::Buy; };
+        std::vector<std::pair<uint64_t, uint64_t>> ids;
+        for (int step = 0; step < 20000; ++step) {
+            const uint64_t k = next() % 10;
+            const Side side = next() & 1 ? Side::Buy : Side::Sell;
+            const int64_t qty = 1 + int64_t(next() % 9);
+            if (k < 3 && !ids.empty()) {
+                const auto [i, j] = ids[next() % ids.size()];
+                assert(ob.cancel(i) == mirror.cancel(j));
+                continue;
+            }
+            std::vector<Trade> t1, t2;
+            if (k < 4) {
+                t1 = ob.add_market(side, qty, step).trades;
+                t2 = mirror.add_market(flip(side), qty, step).trades;
+            } else {
+                const int64_t px = 450 + int64_t(next() % 100);
+                auto r1 = ob.add_limit(side, px, qty, step);
+                auto r2 = mirror.add_limit(flip(side), 1000 - px, qty, step);
+                ids.emplace_back(r1.order_id, r2.order_id);
+                t1 = std::move(r1.trades);
+                t2 = std::move(r2.trades);
+            }
+            assert(t1.size() == t2.size());
+            for (size_t i = 0; i < t1.size(); ++i) assert(t1[i].qty == t2[i].qty && t1[i].px_ticks == 1000 - t2[i].px_ticks);
+        }
+        const auto bb = ob.best_bid(), ma = mirror.best_ask();
+        assert(bb.has_value() == ma.has_value() && (!bb || (bb->px_ticks == 1000 - ma->px_ticks && bb->agg_qty == ma->agg_qty)));
+        // never left crossed
+        if (bb && ob.best_ask()) assert(bb->px_ticks < ob.best_ask()->px_ticks);
+    });
+
+    // --- T17: IOC / FOK / post-only ---
+    for_each_store([&](LevelStore store) {
+        OrderBook ob(BookOptions{ store });
+        ob.add_limit(Side::Sell, 10, 3, 1);
+        ob.add_limit(Side::Sell, 11, 3, 2);
+        ob.add_limit(Side::Sell, 13, 3, 3);
+
+        // IOC: takes what crosses (10 and 11), the rest is dropped, never rests
+        auto ioc = ob.add_limit(Side::Buy, 11, 10, 4, LimitType::IOC);
+        assert(ioc.order_id != 0 && ioc.trades.size() == 2);
+        assert(!ob.best_bid() && ob.best_ask()->px_ticks == 13);
+        assert(!ob.cancel(ioc.order_id));
+        // IOC that crosses nothing: accepted, no trades, nothing rests
+        auto ioc0 = ob.add_limit(Side::Buy, 5, 1, 5, LimitType::IOC);
+        assert(ioc0.order_id != 0 && ioc0.trades.empty() && !ob.best_bid());
+
+        ob.add_limit(Side::Sell, 14, 2, 6);
+        // FOK short of liquidity within its limit: rejected, book untouched, no l2 churn, no allocation
+        std::vector<LevelUpdate> seen;
+        auto on_l2 = [&seen](std::span<const LevelUpdate> u) { seen.insert(seen.end(), u.begin(), u.end()); };
+        ob.attach_level_sink(on_l2);
+        const PoolStats before = ob.pool_stats();
+        const size_t allocs_before = g_allocs;
+        auto sink = [](const Trade&) {};
+        assert(ob.add_limit(Side::Buy, 13, 4, 7, sink, LimitType::FOK) == 0);   // only 3 at <= 13
+        assert(ob.add_limit(Side::Buy, 20, 6, 8, sink, LimitType::FOK) == 0);   // only 5 in the book
+        assert(g_allocs == allocs_before);
+        assert(seen.empty());
+        assert(ob.pool_stats().live == before.live && ob.pool_stats().high_water == before.high_water);
+        assert(ob.depth_at(Side::Sell, 13) == 3 && ob.depth_at(Side::Sell, 14) == 2);
+        // FOK with enough: fills all of it across levels, never rests
+        auto fok = ob.add_limit(Side::Buy, 14, 4, 9, LimitType::FOK);
+        assert(fok.order_id != 0 && fok.trades.size() == 2 && fok.trades[1].qty == 1);
+        assert(ob.depth_at(Side::Sell, 14) == 1 && !ob.best_bid());
+        ob.detach_level_sink();
+
+        // post-only: rests when passive, rejected untouched when it would cross
+        assert(ob.add_limit(Side::Buy, 14, 1, 10, LimitType::PostOnly).order_id == 0);
+        assert(ob.depth_at(Side::Sell, 14) == 1);
+        auto po = ob.add_limit(Side::Buy, 12, 2, 11, LimitType::PostOnly);
+        assert(po.order_id != 0 && po.trades.empty() && ob.best_bid()->px_ticks == 12);
+        assert(ob.add_limit(Side::Sell, 12, 1, 12, LimitType::PostOnly).order_id == 0);
+        assert(ob.add_limit(Side::Sell, 13, 1, 13, LimitType::PostOnly).order_id != 0);
+        assert(ob.depth_at(Side::Sell, 13) == 1);
+
+        // batch path carries the type
+        std::vector<Command> cmds = { Command{ CommandType::AddLimit, Side::Sell, 12, 5, 14, 0, LimitType::FOK },
+                                      Command{ CommandType::AddLimit, Side::Sell, 12, 1, 15, 0, LimitType::IOC } };
+        ResultSink rs;
+        ob.apply_batch(cmds, rs);
+        assert(!rs.acks[0].ok && rs.acks[1].ok && rs.acks[1].trade_count == 1);
+        assert(ob.depth_at(Side::Buy, 12) == 1);
+    });
+
+    // --- T18: lazy cancel == eager cancel, seen through the api; tombstones are reclaimed ---
+    for_each_store([&](LevelStore store) {
+        BookOptions lazy_opts{ store, /*dense_window_ticks=*/128 };
+        lazy_opts.lazy_cancel = true;
+        lazy_opts.compact_min = 8;
+        OrderBook eager(BookOptions{ store, /*dense_window_ticks=*/128 }), lazy(lazy_opts);
+        Lcg next{ 17 };
+        std::vector<std::pair<uint64_t, uint64_t>> ids;  // (eager id, lazy id) of the same order
+        size_t max_tomb = 0;
+        for (int step = 0; step < 30000; ++step) {
+            const uint64_t k = next() % 20;
+            const Side side = next() & 1 ? Side::Buy : Side::Sell;
+            const int64_t qty = 1 + int64_t(next() % 9);
+            std::vector<Trade> t1, t2;
+            if (k < 14 && !ids.empty()) {
+                // cancel-heavy, including repeats of already-gone ids
+                const auto [e, l] = ids[next() % ids.size()];
+                assert(eager.cancel(e) == lazy.cancel(l));
+            } else if (k < 15 && !ids.empty()) {
+                const auto [e, l] = ids[next() % ids.size()];
+                const int64_t px = side == Side::Buy ? 400 + int64_t(next() % 60) : 440 + int64_t(next() % 60);
+                auto r1 = eager.amend(e, qty, px, step);
+                auto r2 = lazy.amend(l, qty, px, step);
+                assert(r1.ok == r2.ok);
+                t1 = std::move(r1.trades);
+                t2 = std::move(r2.trades);
+            } else if (k < 16) {
+                t1 = eager.add_market(side, qty, step).trades;
+                t2 = lazy.add_market(side, qty, step).trades;
+            } else {
+                const int64_t px = side == Side::Buy ? 400 + int64_t(next() % 60) : 440 + int64_t(next() % 60);
+                auto r1 = eager.add_limit(side, px, qty, step);
+                auto r2 = lazy.add_limit(side, px, qty, step);
+                ids.emplace_back(r1.order_id, r2.order_id);
+                t1 = std::move(r1.trades);
+                t2 = std::move(r2.trades);
+            }
+            assert(t1.size() == t2.size());
+            for (size_t i = 0; i < t1.size(); ++i) assert(t1[i].qty == t2[i].qty && t1[i].px_ticks == t2[i].px_ticks);
+            const auto eb = eager.best_bid(), lb = lazy.best_bid(), ea = eager.best_ask(), la = lazy.best_ask();
+            assert(eb.has_value() == lb.has_value() && (!eb || (eb->px_ticks == lb->px_ticks && eb->agg_qty == lb->agg_qty)));
+            assert(ea.has_value() == la.has_value() && (!ea || (ea->px_ticks == la->px_ticks && ea->agg_qty == la->agg_qty)));
+            assert(eager.stats().resting_orders == lazy.stats().resting_orders);
+            max_tomb = std::max(max_tomb, lazy.pool_stats().tombstones);
+        }
+        for (int64_t px = 400; px < 500; ++px)
+            assert(eager.depth_at(Side::Buy, px) == lazy.depth_at(Side::Buy, px) && eager.depth_at(Side::Sell, px) == lazy.depth_at(Side::Sell, px));
+        // tombstones piled up and were reclaimed along the way
+        assert(max_tomb > 0);
+        lazy.compact();
+        assert(lazy.pool_stats().tombstones == 0);
+        assert(lazy.pool_stats().live == eager.pool_stats().live);
+        assert(eager.compact() == 0);
+    });
+
+    // --- T19: mass cancel - by range, by side, everything ---
+    for_each_store([&](LevelStore store) {
+        BookOptions o{ store, /*dense_window_ticks=*/64 };
+        o.lazy_cancel = true;   // tombstones must not be reported a second time
+        OrderBook ob(o);
+        std::vector<uint64_t> bid_ids, ask_ids;
+        for (int64_t px = 1; px <= 10; ++px)
+            for (int k = 0; k < 3; ++k) bid_ids.push_back(ob.add_limit(Side::Buy, px, 1, px * 10 + k).order_id);
+        for (int64_t px = 20; px <= 200; px += 20) ask_ids.push_back(ob.add_limit(Side::Sell, px, 2, px).order_id); // some outside the window
+        assert(ob.cancel(bid_ids[13]));   // px 5, middle of its queue
+
+        std::vector<LevelUpdate> l2;
+        auto on_l2 = [&l2](std::span<const LevelUpdate> u) { l2.assign(u.begin(), u.end()); };
+        ob.attach_level_sink(on_l2);
+
+        // [4, 6] on the bid side: 8 orders (one already cancelled), best level first, FIFO inside
+        std::vector<uint64_t> got;
+        assert(ob.cancel_range(Side::Buy, 4, 6, &got) == 8);
+        const std::vector<uint64_t> want = { bid_ids[15], bid_ids[16], bid_ids[17], bid_ids[12], bid_ids[14],
+                                             bid_ids[9], bid_ids[10], bid_ids[11] };
+        std::sort(got.begin(), got.end());
+        std::vector<uint64_t> sorted_want = want;
+        std::sort(sorted_want.begin(), sorted_want.end());
+        assert(got == sorted_want);
+        assert(l2.size() == 3 && l2[0].px_ticks == 6 && l2[0].agg_qty == 0);   // one batch, one update per level
+        for (int64_t px = 4; px <= 6; ++px) assert(ob.depth_at(Side::Buy, px) == 0);
+        assert(ob.depth_at(Side::Buy, 3) == 3 && ob.depth_at(Side::Buy, 7) == 3);
+        for (uint64_t id : want) assert(!ob.cancel(id));
+        assert(ob.cancel_range(Side::Buy, 4, 6) == 0);     // nothing left there
+        assert(ob.cancel_range(Side::Buy, 9, 2) == 0);     // empty range
+        assert(ob.pool_stats().tombstones == 0);
+
+        // a whole side
+        assert(ob.cancel_side(Side::Sell) == ask_ids.size());
+        assert(!ob.best_ask() && ob.best_bid()->px_ticks == 10);
+        ob.detach_level_sink();
+
+        // the book keeps working afterwards, on both sides
+        const uint64_t fresh_ask = ob.add_limit(Side::Sell, 50, 1, 500).order_id;
+        assert(ob.best_ask()->px_ticks == 50);
+        got.clear();
+        assert(ob.cancel_all(&got) == 7 * 3 + 1);
+        assert(std::find(got.begin(), got.end(), fresh_ask) != got.end());
+        assert(!ob.best_bid() && !ob.best_ask() && ob.pool_stats().live == 0 && ob.stats().bid_levels == 0);
+        assert(ob.add_limit(Side::Buy, 5, 1, 600).order_id != 0 && ob.best_bid()->px_ticks == 5);
+
+        // cancel_all on the per-side path (too few orders for a slot sweep) is still one command:
+        // one batch holding both sides' levels
+        ob.add_limit(Side::Buy, 4, 1, 601);
+        ob.add_limit(Side::Sell, 30, 1, 602);
+        std::vector<std::vector<LevelUpdate>> batches;
+        auto on_batch = [&batches](std::span<const LevelUpdate> u) { batches.emplace_back(u.begin(), u.end()); };
+        ob.attach_level_sink(on_batch);
+        assert(ob.cancel_all() == 3);
+        assert(batches.size() == 1 && batches[0].size() == 3);
+        ob.detach_level_sink();
+    });
+
+    // --- T20: recycled levels, memory accounting, shrink() ---
+    for_each_store([&](LevelStore store) {
+        OrderBook ob(BookOptions{ store, /*dense_window_ticks=*/64 });
+        auto sink = [](const Trade&) {};
+        // a touch that keeps emptying and re-creating the same levels: once warm, no allocation
+        // (the Map ladder re-keys its erased tree nodes)
+        ob.add_limit(Side::Sell, 101, 1, 1);
+        ob.add_limit(Side::Sell, 102, 1, 2);
+        ob.add_market(Side::Buy, 2, 3, sink);
+        const size_t allocs_before = g_allocs;
+        for (uint64_t ts = 4; ts < 404; ts += 4) {
+            ob.add_limit(Side::Sell, 102, 1, ts, sink);
+            ob.add_limit(Side::Sell, 101, 1, ts + 1, sink);
+            ob.add_market(Side::Buy, 2, ts + 2, sink);
+        }
+        assert(g_allocs == allocs_before);
+        assert(!ob.best_ask());
+
+        // a busy session: every structure grows, and the numbers say so
+        const MemoryUsage idle = ob.memory_usage();
+        assert(idle.orders > 0 && idle.total() >= idle.orders + idle.levels + idle.price_index);
+        std::vector<uint64_t> ids;
+        for (int64_t i = 0; i < 5000; ++i) ids.push_back(ob.add_limit(Side::Buy, 1000 - i % 200, 1, 1000 + i).order_id);
+        const MemoryUsage busy = ob.memory_usage();
+        assert(busy.orders > idle.orders && busy.levels > idle.levels && busy.total() > idle.total());
+        if (store == LevelStore::Map) assert(busy.price_index > idle.price_index);
+
+        // most of it ends; one order at a low slot survives
+        for (size_t k = 1; k < ids.size(); ++k) assert(ob.cancel(ids[k]));
+        const size_t cap = ob.pool_stats().capacity;
+        const MemoryUsage pooled = ob.memory_usage();
+        assert(pooled.orders == busy.orders && pooled.levels >= busy.levels);   // pooled, not released
+        const size_t freed = ob.shrink();
+        const MemoryUsage after = ob.memory_usage();
+        assert(freed == pooled.total() - after.total() && freed > 0);
+        assert(after.orders < busy.orders && after.levels < busy.levels && ob.pool_stats().capacity < cap);
+        assert(ob.shrink() == 0);                              // nothing left to give back
+        assert(ob.depth_at(Side::Buy, 1000) == 1 && ob.best_bid()->px_ticks == 1000);
+
+        // ids of dropped slots stay dead, even once the pool grows back over them
+        std::vector<uint64_t> again;
+        for (int64_t i = 0; i < 5000; ++i) again.push_back(ob.add_limit(Side::Buy, 50, 1, 9000 + i).order_id);
+        for (size_t k = 1; k < ids.size(); ++k) assert(!ob.cancel(ids[k]));
+        assert(ob.depth_at(Side::Buy, 50) == 5000);
+        for (uint64_t id : again) assert(ob.cancel(id));
+        assert(ob.cancel(ids[0]));                             // the survivor kept its id
+    });
+    {
+        // never below the preallocated capacity
+        BookOptions o;
+        o.order_capacity = 1000;
+        OrderBook ob(o);
+        for (int64_t i = 0; i < 3000; ++i) ob.add_limit(Side::Sell, 10 + i % 7, 1, i);
+        ob.cancel_all();
+        ob.shrink();
+        assert(ob.pool_stats().capacity == 1001);
+    }
+
+    // --- T21: a tombstone's retired generation is not a live id ---
+    for_each_store([&](LevelStore store) {
+        BookOptions o{ store, /*dense_window_ticks=*/64 };
+        o.lazy_cancel = true;
+        o.compact_min = 64;     // keep the tombstone queued
+        OrderBook ob(o);
+        auto sink = [](const Trade&) {};
+        ob.add_limit(Side::Buy, 10, 4, 1);
+        const uint64_t a = ob.add_limit(Side::Buy, 10, 4, 2).order_id;
+        ob.add_limit(Side::Buy, 10, 4, 3);
+        assert(ob.cancel(a));
+        const uint64_t forged = a + (uint64_t{1} << 32);   // the generation the tombstone sits under
+        assert(!ob.cancel(forged) && !ob.cancel(a));
+        assert(!ob.amend(forged, 5, 10, 4, sink) && !ob.amend(forged, 6, 11, 5, sink));
+        assert(ob.depth_at(Side::Buy, 10) == 8 && ob.depth_at(Side::Buy, 11) == 0);
+        assert(ob.pool_stats().tombstones == 1 && ob.stats().resting_orders == 2);
+        // the tombstone is still skipped by matching
+        const auto r = ob.add_limit(Side::Sell, 10, 8, 6);
+        assert(r.trades.size() == 2 && r.trades[0].maker_order_id != a && r.trades[1].maker_order_id != a);
+        assert(!ob.best_bid() && ob.pool_stats().tombstones == 0);
+    });
 
     return 0; // success
 
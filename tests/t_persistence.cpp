@@ -0,0 +1,369 @@
+// crash-recovery tests: a book rebuilt from disk must be indistinguishable from the original
+// (same levels, same FIFO order, same ids) - checked only through the public api
+
+#include "OrderBook.hpp"
+#include "Journal.hpp"
+#include "TestUtil.hpp"
+#include <algorithm>    // std::max
+#include <cassert>
+#include <csignal>      // ignore SIGXFSZ: a capped file size makes write() fail instead
+#include <sys/resource.h> // setrlimit(RLIMIT_FSIZE): simulate a full disk
+#include <cstdio>       // std::remove
+#include <filesystem>   // temp dir for the files
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::string temp_path(const char* name) {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    // same top of book and depth on both sides over a price band
+    void assert_same_book(const OrderBook& a, const OrderBook& b, int64_t lo, int64_t hi) {
+        auto ab = a.best_bid(), bb = b.best_bid(), aa = a.best_ask(), ba = b.best_ask();
+        assert(ab.has_value() == bb.has_value() && (!ab || (ab->px_ticks == bb->px_ticks && ab->agg_qty == bb->agg_qty)));
+        assert(aa.has_value() == ba.has_value() && (!aa || (aa->px_ticks == ba->px_ticks && aa->agg_qty == ba->agg_qty)));
+        for (int64_t px = lo; px <= hi; ++px) {
+            assert(a.depth_at(Side::Buy, px)  == b.depth_at(Side::Buy, px));
+            assert(a.depth_at(Side::Sell, px) == b.depth_at(Side::Sell, px));
+        }
+    }
+
+} // end anonymous namespace
+
+int main() {
+    // --- J1: journal every accepted command, replay into a fresh book ---
+    const std::string jpath = temp_path("miniex_t_journal.bin");
+    std::remove(jpath.c_str());
+
+    OrderBook live;
+    std::vector<uint64_t> resting;
+    {
+        Journal j;
+        JournalOptions jo;
+        jo.buffer_bytes = 256;   // tiny buffer: forces several write()s
+        jo.fsync_every  = 50;
+        assert(j.open(jpath, jo));
+        live.attach_journal(&j);
+
+        Lcg next{ 7 };
+        for (uint64_t ts = 1; ts <= 2000; ++ts) {
+            const uint64_t op = next() % 10;
+            const int64_t  px = 100 + static_cast<int64_t>(next() % 40);
+            const int64_t  q  = 1 + static_cast<int64_t>(next() % 9);
+            if (op < 4)      resting.push_back(live.add_limit(Side::Buy, px, q, ts).order_id);
+            else if (op < 7) resting.push_back(live.add_limit(Side::Sell, px + 30, q, ts, LimitType(next() % 4)).order_id);
+            else if (op < 9 && !resting.empty()) {
+                const uint64_t id = resting[next() % resting.size()];
+                // either may miss (already filled / cancelled): misses are not journaled
+                if (next() % 2) live.cancel(id);
+                else            live.amend(id, q, op % 2 ? px : px + 30, ts);
+            }
+            else             live.add_market(op % 2 ? Side::Buy : Side::Sell, q, ts);
+        }
+        live.add_limit(Side::Buy, /*px=*/5, /*qty=*/0, /*ts=*/9999);   // rejected: not journaled
+        live.attach_journal(nullptr);
+        assert(j.records() > 0);
+    } // journal closed here: flushed + fsynced
+
+    OrderBook rebuilt;
+    JournalReplay rep = Journal::replay(jpath, rebuilt);
+    assert(rep.ok);
+    assert(rep.mismatches == 0);   // every replayed command got the id it was logged with
+    assert_same_book(live, rebuilt, 90, 180);
+    // ids survive the rebuild: cancelling a live order works on both books the same way
+    for (uint64_t id : resting) assert(live.cancel(id) == rebuilt.cancel(id));
+    assert_same_book(live, rebuilt, 90, 180);
+
+    // --- J2: reopening appends after the existing records ---
+    {
+        Journal j;
+        assert(j.open(jpath));
+        OrderBook tail;
+        tail.attach_journal(&j);
+        tail.add_limit(Side::Buy, /*px=*/1, /*qty=*/1, /*ts=*/1);
+        tail.attach_journal(nullptr);
+    }
+    OrderBook again;
+    JournalReplay rep2 = Journal::replay(jpath, again);
+    assert(rep2.ok && rep2.records == rep.records + 1);
+
+    // --- J3: not a journal -> refused, book untouched ---
+    const std::string bogus = temp_path("miniex_t_bogus.bin");
+    if (std::FILE* f = std::fopen(bogus.c_str(), "wb")) { std::fputs("definitely not a journal header", f); std::fclose(f); }
+    OrderBook untouched;
+    assert(!Journal::replay(bogus, untouched).ok);
+    Journal refuse;
+    assert(!refuse.open(bogus));
+    assert(!untouched.best_bid().has_value());
+    assert(!Journal::replay(temp_path("miniex_t_missing.bin"), untouched).ok);
+
+    // --- J4: torn last record (crash mid-write) -> reopening cuts it off before appending ---
+    {
+        const std::string tj = temp_path("miniex_t_torn_journal.bin");
+        std::remove(tj.c_str());
+        OrderBook live;
+        {
+            Journal j;
+            assert(j.open(tj));
+            live.attach_journal(&j);
+            for (int64_t i = 0; i < 10; ++i) live.add_limit(Side::Sell, 30 + i, 1, static_cast<uint64_t>(i));
+            live.attach_journal(nullptr);
+        }
+        std::filesystem::resize_file(tj, std::filesystem::file_size(tj) - 20);
+        OrderBook rebuilt;
+        const JournalReplay r1 = Journal::replay(tj, rebuilt);
+        assert(r1.ok && r1.records == 9 && r1.mismatches == 0);
+        {
+            Journal j;
+            assert(j.open(tj));
+            assert((std::filesystem::file_size(tj) - sizeof(JournalHeader)) % sizeof(Command) == 0);
+            rebuilt.attach_journal(&j);
+            for (int64_t i = 0; i < 5; ++i) rebuilt.add_limit(Side::Buy, 10 + i, 1, static_cast<uint64_t>(100 + i));
+            rebuilt.attach_journal(nullptr);
+            assert(j.records() == 5 && j.dropped() == 0 && !j.failed());
+        }
+        OrderBook again2;
+        const JournalReplay r2 = Journal::replay(tj, again2);
+        assert(r2.ok && r2.records == 14 && r2.mismatches == 0);
+        assert_same_book(rebuilt, again2, 0, 50);
+        assert(again2.best_ask()->px_ticks == 30 && again2.depth_at(Side::Sell, 39) == 0);
+        std::remove(tj.c_str());
+    }
+
+    // --- J5: a failing write keeps the unwritten records buffered and says so ---
+    {
+        const std::string fj = temp_path("miniex_t_full_journal.bin");
+        std::remove(fj.c_str());
+        Journal j;
+        JournalOptions small;
+        small.buffer_bytes = 4 * sizeof(Command);
+        assert(j.open(fj, small));
+        // the file may not grow past header + 2 records: write() fails with EFBIG from there on
+        std::signal(SIGXFSZ, SIG_IGN);
+        rlimit old{};
+        ::getrlimit(RLIMIT_FSIZE, &old);
+        rlimit cap = old;
+        cap.rlim_cur = sizeof(JournalHeader) + 2 * sizeof(Command);
+        ::setrlimit(RLIMIT_FSIZE, &cap);
+
+        OrderBook live;
+        live.attach_journal(&j);
+        for (int64_t i = 0; i < 10; ++i) live.add_limit(Side::Buy, 10 + i, 1, static_cast<uint64_t>(i));
+        live.attach_journal(nullptr);
+        assert(j.failed() && !j.flush());
+        // 4 fill the buffer; the 5th flushes 2 of them (all that fit) and leaves room for 2 more;
+        // after that nothing can be written and the last 4 are refused
+        assert(j.records() == 6 && j.dropped() == 4);
+
+        // space comes back: the records still buffered are written, none lost
+        ::setrlimit(RLIMIT_FSIZE, &old);
+        assert(j.sync() && !j.failed());
+        j.close();
+        OrderBook rebuilt;
+        const JournalReplay r = Journal::replay(fj, rebuilt);
+        assert(r.ok && r.records == 6 && r.mismatches == 0);
+        assert(rebuilt.best_bid()->px_ticks == 15);
+        std::remove(fj.c_str());
+    }
+
+    // --- S1: snapshot -> restore keeps levels, FIFO priority and ids ---
+    const std::string spath = temp_path("miniex_t_snapshot.bin");
+    OrderBook src;
+    auto o1 = src.add_limit(Side::Buy,  /*px=*/100, /*qty=*/3, /*ts=*/1);
+    auto o2 = src.add_limit(Side::Buy,  /*px=*/100, /*qty=*/4, /*ts=*/2);
+    auto o3 = src.add_limit(Side::Buy,  /*px=*/99,  /*qty=*/5, /*ts=*/3);
+    auto o4 = src.add_limit(Side::Sell, /*px=*/105, /*qty=*/6, /*ts=*/4);
+    auto o5 = src.add_limit(Side::Buy,  /*px=*/100, /*qty=*/1, /*ts=*/5);
+    assert(src.cancel(o2.order_id));                // leaves a free slot in the middle of the table
+    assert(src.snapshot(spath));
+
+    // restore into a book with a different ladder and some junk that must disappear
+    OrderBook dst(BookOptions{ LevelStore::Dense, /*dense_window_ticks=*/64 });
+    dst.add_limit(Side::Sell, /*px=*/7, /*qty=*/7, /*ts=*/7);
+    assert(dst.restore(spath));
+    assert_same_book(src, dst, 90, 110);
+    assert(dst.depth_at(Side::Sell, 7) == 0);
+    // FIFO survived: a sweep hits o1 then o5 at 100, then o3 at 99
+    auto sweep = dst.add_market(Side::Sell, /*qty=*/6, /*ts=*/10);
+    assert(sweep.trades.size() == 3);
+    assert(sweep.trades[0].maker_order_id == o1.order_id);
+    assert(sweep.trades[1].maker_order_id == o5.order_id);
+    assert(sweep.trades[2].maker_order_id == o3.order_id && sweep.trades[2].qty == 2);
+    // resting ids still cancel, stale ones still don't
+    assert(dst.cancel(o4.order_id));
+    assert(!dst.cancel(o2.order_id));
+    // the next id matches what the original book hands out
+    OrderBook dst2;
+    assert(dst2.restore(spath));
+    assert(dst2.add_limit(Side::Buy, 1, 1, 20).order_id == src.add_limit(Side::Buy, 1, 1, 20).order_id);
+
+    // --- S2: snapshot + journal tail == live book ---
+    const std::string tpath = temp_path("miniex_t_tail.bin");
+    std::remove(tpath.c_str());
+    {
+        Journal j;
+        assert(j.open(tpath));
+        src.attach_journal(&j);
+        src.add_limit(Side::Sell, /*px=*/100, /*qty=*/2, /*ts=*/30);   // crosses the restored bids
+        src.cancel(o3.order_id);
+        src.add_limit(Side::Buy, /*px=*/101, /*qty=*/9, /*ts=*/31);
+        src.attach_journal(nullptr);
+    }
+    OrderBook recovered;
+    assert(recovered.restore(spath));
+    assert(recovered.add_limit(Side::Buy, 1, 1, 20).order_id != 0);   // same extra order the live book got after the snapshot
+    JournalReplay tail = Journal::replay(tpath, recovered);
+    assert(tail.ok && tail.records == 3 && tail.mismatches == 0);
+    assert_same_book(src, recovered, 0, 110);
+
+    // --- S3: not a snapshot / truncated -> false, book unchanged ---
+    OrderBook keep;
+    keep.add_limit(Side::Buy, /*px=*/42, /*qty=*/1, /*ts=*/1);
+    assert(!keep.restore(bogus));
+    assert(!keep.restore(jpath));   // a journal is not a snapshot
+    std::filesystem::resize_file(spath, std::filesystem::file_size(spath) - 4);
+    assert(!keep.restore(spath));
+    assert(keep.depth_at(Side::Buy, 42) == 1);
+
+    // --- S4: snapshot edge cases ---
+    {
+        // an empty book (no slots at all) round-trips
+        OrderBook empty, into;
+        into.add_limit(Side::Sell, 7, 1, 1);
+        assert(empty.snapshot(spath) && into.restore(spath));
+        assert(!into.best_bid() && !into.best_ask());
+
+        // a snapshot that cannot be completed leaves the previous one untouched
+        assert(keep.snapshot(spath));
+        const std::string tmp = spath + ".tmp";
+        std::filesystem::create_directory(tmp);   // the temp file cannot be created
+        assert(!empty.snapshot(spath));
+        std::filesystem::remove(tmp);
+        OrderBook back;
+        assert(back.restore(spath) && back.depth_at(Side::Buy, 42) == 1);
+        assert(!std::filesystem::exists(tmp));
+
+        // level counts chosen so the size check would wrap to exactly the header size
+        struct RawHeader { char magic[8]; uint32_t version, gen_floor; uint64_t bid_levels, ask_levels, orders, slots, free; };
+        RawHeader raw{ { 'M', 'N', 'X', 'S', 'N', 'A', 'P', '\0' }, 3, 1, uint64_t{1} << 61, 0, 0, 0, 0 };
+        if (std::FILE* f = std::fopen(bogus.c_str(), "wb")) { std::fwrite(&raw, sizeof(raw), 1, f); std::fclose(f); }
+        assert(!back.restore(bogus));
+        assert(back.depth_at(Side::Buy, 42) == 1);
+    }
+
+    // --- L1: lazy cancel - tombstones survive snapshot + journal, so ids stay identical ---
+    {
+        BookOptions lazy;
+        lazy.lazy_cancel = true;
+        lazy.compact_min = 1u << 30;   // only explicit compact() reclaims here
+        const std::string lj = temp_path("miniex_t_lazy_journal.bin");
+        std::remove(lj.c_str());
+        OrderBook a(lazy);
+        Journal j;
+        assert(j.open(lj));
+        a.attach_journal(&j);
+        auto l1 = a.add_limit(Side::Buy, 50, 1, 1);
+        auto l2 = a.add_limit(Side::Buy, 50, 2, 2);
+        a.add_limit(Side::Buy, 50, 3, 3);
+        assert(a.cancel(l1.order_id) && a.cancel(l2.order_id));   // two tombstones at the front of 50
+        assert(a.pool_stats().tombstones == 2 && a.depth_at(Side::Buy, 50) == 3);
+        assert(a.snapshot(spath));
+
+        OrderBook b(lazy);
+        assert(b.restore(spath));
+        assert(b.pool_stats().tombstones == 2 && !b.cancel(l1.order_id));
+        assert(a.compact() == 2 && b.compact() == 2);
+        assert(a.add_limit(Side::Sell, 60, 1, 4).order_id == b.add_limit(Side::Sell, 60, 1, 4).order_id);
+        a.add_limit(Side::Sell, 61, 1, 5);
+        assert(a.cancel_range(Side::Sell, 61, 100) == 1);   // journaled as one CancelRange record
+
+        a.attach_journal(nullptr);
+        j.close();
+        OrderBook c(lazy);
+        const JournalReplay r = Journal::replay(lj, c);   // includes the journaled Compact
+        assert(r.ok && r.mismatches == 0);
+        assert_same_book(a, c, 40, 70);
+        assert(c.pool_stats().tombstones == 0);
+        std::remove(lj.c_str());
+    }
+
+    // --- M1: mass cancels pick a slot sweep or queue walks from the book's shape; either way the
+    //         journaled records rebuild the same free list, so later ids match ---
+    {
+        const std::string mj = temp_path("miniex_t_mass_journal.bin");
+        std::remove(mj.c_str());
+        OrderBook a;
+        Journal j;
+        assert(j.open(mj));
+        a.attach_journal(&j);
+        uint64_t ts = 0;
+        // sides interleaved in the slot table, so release order across sides shows in later ids
+        auto fill = [&](int64_t bids, int64_t asks) {
+            for (int64_t i = 0; i < std::max(bids, asks); ++i) {
+                if (i < bids) a.add_limit(Side::Buy, 10 + i % 7, 1, ++ts);
+                if (i < asks) a.add_limit(Side::Sell, 30 + i % 5, 1, ++ts);
+            }
+        };
+        fill(400, 300);
+        assert(a.cancel_all() == 700);        // both sides big: one combined sweep
+        fill(500, 3);
+        assert(a.cancel_side(Side::Sell) == 3);   // a small side: queue walks
+        assert(a.cancel_all() == 500);        // one side empty: per-side path
+        fill(200, 200);
+        a.cancel_range(Side::Buy, 12, 14);
+        std::vector<uint64_t> after;
+        for (int64_t i = 0; i < 50; ++i) after.push_back(a.add_limit(Side::Sell, 40, 1, ++ts).order_id);
+        a.attach_journal(nullptr);
+        j.close();
+
+        OrderBook c;
+        const JournalReplay r = Journal::replay(mj, c);
+        assert(r.ok && r.mismatches == 0);
+        assert_same_book(a, c, 0, 50);
+        for (uint64_t id : after) assert(c.cancel(id));
+        std::remove(mj.c_str());
+    }
+
+    // --- S5: shrink() drops order slots, which changes future ids: journaled, and the
+    //         generation floor it leaves behind is part of the snapshot ---
+    {
+        const std::string sj = temp_path("miniex_t_shrink_journal.bin");
+        std::remove(sj.c_str());
+        OrderBook a;
+        Journal j;
+        assert(j.open(sj));
+        a.attach_journal(&j);
+        std::vector<uint64_t> ids;
+        for (int64_t i = 0; i < 300; ++i) ids.push_back(a.add_limit(Side::Buy, 10 + i % 5, 1, i).order_id);
+        for (size_t k = 1; k < ids.size(); ++k) assert(a.cancel(ids[k]));
+        assert(a.shrink() > 0);
+        assert(a.snapshot(spath));
+        // regrow over the dropped slots: new generations, old ids stay dead
+        for (int64_t i = 0; i < 300; ++i) a.add_limit(Side::Sell, 20 + i % 5, 1, 1000 + i);
+        for (size_t k = 1; k < ids.size(); ++k) assert(!a.cancel(ids[k]));
+
+        OrderBook b;
+        assert(b.restore(spath));
+        for (int64_t i = 0; i < 300; ++i) b.add_limit(Side::Sell, 20 + i % 5, 1, 1000 + i);
+        for (size_t k = 1; k < ids.size(); ++k) assert(!b.cancel(ids[k]));
+        assert_same_book(a, b, 0, 40);
+        assert(a.add_limit(Side::Buy, 1, 1, 5000).order_id == b.add_limit(Side::Buy, 1, 1, 5000).order_id);
+
+        a.attach_journal(nullptr);
+        j.close();
+        OrderBook c;
+        const JournalReplay r = Journal::replay(sj, c);   // includes the journaled Shrink
+        assert(r.ok && r.mismatches == 0);
+        assert_same_book(a, c, 0, 40);
+        assert(c.pool_stats().capacity == a.pool_stats().capacity);
+        std::remove(sj.c_str());
+    }
+
+    std::remove(jpath.c_str());
+    std::remove(bogus.c_str());
+    std::remove(spath.c_str());
+    std::remove(tpath.c_str());
+    return 0;
+}
@@ -0,0 +1,141 @@
+// parallel replay tests: any thread count must give exactly what a plain serial loop gives
+
+#include "OrderBook.hpp"
+#include "BookManager.hpp"
+#include "Replay.hpp"
+#include "TestUtil.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+    // seeded multi-symbol flow. skewed symbol choice so job sizes differ a lot (stealing matters);
+    // cancels target ids the serial reference handed out, so they hit as often as in real flow
+    std::vector<SymbolCommand> make_flow(size_t n, uint32_t symbols, uint64_t seed, bool monotonic_ts,
+                                         const std::vector<std::vector<uint64_t>>& ids = {}) {
+        Lcg next{ seed };
+        std::vector<SymbolCommand> out;
+        out.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t r = next();
+            const uint32_t sym = static_cast<uint32_t>((r % symbols) * (r % symbols) / symbols); // low ids busier
+            SymbolCommand sc{ sym * 3 + 1, Command{} };                                        // sparse ids
+            Command& c = sc.cmd;
+            c.ts = monotonic_ts ? i / 4 : next() % 1000;
+            const uint64_t k = next() % 10;
+            if (k < 2 && sym < ids.size() && !ids[sym].empty()) {
+                c.type = CommandType::Cancel;
+                c.order_id = ids[sym][next() % ids[sym].size()];
+            } else if (k < 3) {
+                c.type = CommandType::AddMarket;
+                c.side = next() & 1 ? Side::Buy : Side::Sell;
+                c.qty  = 1 + int64_t(next() % 6);
+            } else {
+                c.type     = CommandType::AddLimit;
+                c.side     = next() & 1 ? Side::Buy : Side::Sell;
+                c.px_ticks = c.side == Side::Buy ? 95 + int64_t(next() % 10) : 100 + int64_t(next() % 10);
+                c.qty      = 1 + int64_t(next() % 9);
+            }
+            out.push_back(sc);
+        }
+        return out;
+    }
+
+    // the thing replay() has to match: one loop, one call per event, then order fills by (ts, event)
+    ReplayResult serial(std::span<const SymbolCommand> events) {
+        BookManager books;
+        ReplayResult res;
+        for (size_t i = 0; i < events.size(); ++i) {
+            OrderBook& ob = books.add_symbol(events[i].symbol_id);
+            const Command& c = events[i].cmd;
+            uint32_t n = 0;
+            auto sink = [&](const Trade& t) { res.trades.push_back(ReplayTrade{ i, events[i].symbol_id, t }); ++n; };
+            CommandAck ack = ob.dispatch(c, sink);
+            ack.trade_count = n;
+            res.acks.push_back(ack);
+        }
+        std::stable_sort(res.trades.begin(), res.trades.end(), [](const ReplayTrade& a, const ReplayTrade& b) {
+            return a.trade.ts < b.trade.ts;
+        });
+        return res;
+    }
+
+    void assert_same(const ReplayResult& a, const ReplayResult& b) {
+        assert(a.acks.size() == b.acks.size());
+        for (size_t i = 0; i < a.acks.size(); ++i) {
+            assert(a.acks[i].order_id == b.acks[i].order_id && a.acks[i].ok == b.acks[i].ok);
+            assert(a.acks[i].trade_count == b.acks[i].trade_count);
+        }
+        assert(a.trades.size() == b.trades.size());
+        for (size_t i = 0; i < a.trades.size(); ++i) {
+            const ReplayTrade& x = a.trades[i];
+            const ReplayTrade& y = b.trades[i];
+            assert(x.event == y.event && x.symbol_id == y.symbol_id);
+            assert(x.trade.maker_order_id == y.trade.maker_order_id && x.trade.taker_order_id == y.trade.taker_order_id);
+            assert(x.trade.px_ticks == y.trade.px_ticks && x.trade.qty == y.trade.qty && x.trade.ts == y.trade.ts);
+        }
+    }
+
+    // ids each symbol's book will hand out for the flow, so a second flow can cancel them
+    std::vector<std::vector<uint64_t>> ids_by_symbol(const std::vector<SymbolCommand>& flow, const ReplayResult& r) {
+        std::vector<std::vector<uint64_t>> ids;
+        for (size_t i = 0; i < flow.size(); ++i) {
+            const uint32_t sym = (flow[i].symbol_id - 1) / 3;
+            if (sym >= ids.size()) ids.resize(sym + 1);
+            if (flow[i].cmd.type == CommandType::AddLimit && r.acks[i].ok) ids[sym].push_back(r.acks[i].order_id);
+        }
+        return ids;
+    }
+
+} // end anonymous namespace
+
+int main() {
+    for (bool monotonic : { true, false }) {
+        // --- R1: 1, 2, 4, 8 threads == serial loop (monotonic ts: k-way merge; shuffled ts: sort path) ---
+        const auto seed_flow = make_flow(20000, 64, 7, monotonic);
+        const auto flow = make_flow(60000, 64, 11, monotonic, ids_by_symbol(seed_flow, serial(seed_flow)));
+        // replay the cancel-free warm-up first so the cancels in flow find live orders
+        std::vector<SymbolCommand> all(seed_flow);
+        all.insert(all.end(), flow.begin(), flow.end());
+        const ReplayResult ref = serial(all);
+        assert(!ref.trades.empty());
+
+        for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+            BookManager books;
+            ReplayOptions opts;
+            opts.threads = threads;
+            const ReplayResult got = replay(all, books, opts);
+            assert_same(got, ref);
+        }
+    }
+
+    // --- R2: add_symbols off -> events for unknown symbols are rejected, the rest still run ---
+    {
+        BookManager books;
+        books.add_symbol(5, BookOptions{ LevelStore::Dense });
+        std::vector<SymbolCommand> ev = {
+            { 5, Command{ CommandType::AddLimit, Side::Sell, 100, 3, 1, 0 } },
+            { 6, Command{ CommandType::AddLimit, Side::Sell, 100, 3, 2, 0 } },  // unknown
+            { 5, Command{ CommandType::AddMarket, Side::Buy, 0, 2, 3, 0 } },
+        };
+        ReplayOptions opts;
+        opts.threads = 4;
+        opts.add_symbols = false;
+        const ReplayResult r = replay(ev, books, opts);
+        assert(books.size() == 1 && books.find(6) == nullptr);
+        assert(r.acks[0].ok && !r.acks[1].ok && r.acks[1].order_id == 0 && r.acks[2].ok);
+        assert(r.trades.size() == 1 && r.trades[0].event == 2 && r.trades[0].trade.qty == 2);
+        assert(books.find(5)->depth_at(Side::Sell, 100) == 1);
+    }
+
+    // --- R3: empty input ---
+    {
+        BookManager books;
+        const ReplayResult r = replay({}, books);
+        assert(r.acks.empty() && r.trades.empty());
+    }
+
+    return 0; // success
+}
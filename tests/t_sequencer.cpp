@@ -0,0 +1,167 @@
+// sequencer tests: the ring on its own, then whole gateway threads -> matching thread -> reports
+// a book driven through the sequencer must end up exactly where the same commands applied
+// directly would have left it
+
+#include "OrderBook.hpp"
+#include "BookManager.hpp"
+#include "Sequencer.hpp"
+#include "SpscRing.hpp"
+#include "TestUtil.hpp"
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    // what one gateway thread saw: the commands it actually sent and every report it got back
+    struct Session {
+        std::vector<Command> sent;
+        std::vector<Report>  reports;
+    };
+
+    // producer thread body: n commands on one symbol, reading reports as they arrive and
+    // cancelling some of the orders it learns about, the way a real gateway would
+    void drive(Sequencer::Producer& p, uint32_t symbol, int n, uint64_t seed, Session& out) {
+        Lcg next{ seed };
+        std::vector<uint64_t> known;  // resting candidates from acks
+        size_t acks = 0;
+        Report r;
+        auto drain = [&] {
+            while (p.poll(r)) {
+                out.reports.push_back(r);
+                if (r.type == ReportType::Ack) {
+                    ++acks;
+                    if (r.ack.ok && r.ack.order_id) known.push_back(r.ack.order_id);
+                }
+            }
+        };
+        for (int i = 0; i < n; ++i) {
+            Command c{};
+            const uint64_t k = next() % 10;
+            if (k < 2 && !known.empty()) {
+                c.type = CommandType::Cancel;
+                c.order_id = known[next() % known.size()];
+            } else if (k < 3) {
+                c.type = CommandType::AddMarket;
+                c.side = next() & 1 ? Side::Buy : Side::Sell;
+                c.qty  = 1 + int64_t(next() % 5);
+                c.ts   = uint64_t(i);
+            } else {
+                c.type     = CommandType::AddLimit;
+                c.side     = next() & 1 ? Side::Buy : Side::Sell;
+                c.px_ticks = c.side == Side::Buy ? 90 + int64_t(next() % 12) : 99 + int64_t(next() % 12);
+                c.qty      = 1 + int64_t(next() % 9);
+                c.ts       = uint64_t(i);
+            }
+            while (!p.submit(symbol, c)) { drain(); std::this_thread::yield(); } // full -> make room by reading our reports
+            out.sent.push_back(c);
+            drain();
+        }
+        while (acks < out.sent.size()) { drain(); std::this_thread::yield(); }
+    }
+
+    // the same commands straight into a fresh book must produce the same reports
+    void check_against_direct(const Session& s, uint32_t symbol) {
+        OrderBook ob;
+        size_t ri = 0;
+        uint64_t last_seq = 0;
+        for (const Command& c : s.sent) {
+            std::vector<Trade> trades;
+            auto sink = [&](const Trade& t) { trades.push_back(t); };
+            const CommandAck want = ob.dispatch(c, sink);
+            for (const Trade& t : trades) {
+                const Report& r = s.reports[ri++];
+                assert(r.type == ReportType::Trade && r.symbol_id == symbol);
+                assert(r.trade.maker_order_id == t.maker_order_id && r.trade.taker_order_id == t.taker_order_id);
+                assert(r.trade.px_ticks == t.px_ticks && r.trade.qty == t.qty);
+            }
+            const Report& a = s.reports[ri++];
+            assert(a.type == ReportType::Ack && a.symbol_id == symbol);
+            assert(a.ack.order_id == want.order_id && a.ack.ok == want.ok && a.ack.trade_count == trades.size());
+            assert(a.seq > last_seq); // global order, so strictly increasing per producer too
+            last_seq = a.seq;
+        }
+        assert(ri == s.reports.size());
+    }
+
+} // end anonymous namespace
+
+int main() {
+    // --- Q1: ring basics - power-of-two capacity, full / empty, wrap-around ---
+    {
+        SpscRing<int> ring(5);
+        assert(ring.capacity() == 8 && ring.empty());
+        int v = 0;
+        assert(!ring.try_pop(v));
+        for (int round = 0; round < 3; ++round) {  // indices run past the slot count
+            for (int i = 0; i < 8; ++i) assert(ring.try_push(round * 8 + i));
+            assert(!ring.try_push(-1));
+            for (int i = 0; i < 8; ++i) { assert(ring.try_pop(v)); assert(v == round * 8 + i); }
+            assert(!ring.try_pop(v) && ring.empty());
+        }
+    }
+
+    // --- Q2: ring across two threads keeps every item, in order ---
+    {
+        SpscRing<uint64_t> ring(64);
+        constexpr uint64_t N = 1'000'000;
+        // yield when blocked: the test has to finish on a single-cpu box too
+        std::thread prod([&] { for (uint64_t i = 1; i <= N; ++i) while (!ring.try_push(i)) std::this_thread::yield(); });
+        uint64_t expect = 1, v = 0;
+        while (expect <= N) {
+            if (ring.try_pop(v)) { assert(v == expect); ++expect; }
+            else std::this_thread::yield();
+        }
+        prod.join();
+        assert(ring.empty());
+    }
+
+    // --- Q3: two gateway threads, one book each, small rings so both sides hit full ---
+    {
+        BookManager books;
+        books.add_symbol(7);
+        books.add_symbol(8);
+        SequencerOptions opts;
+        opts.command_ring = 16;
+        opts.report_ring  = 16;
+        opts.burst        = 4;
+        Sequencer seq(books, opts);
+        Sequencer::Producer& a = seq.add_producer();
+        Sequencer::Producer& b = seq.add_producer();
+        assert(seq.start());
+        assert(!seq.start());
+
+        Session sa, sb;
+        std::thread ta([&] { drive(a, 7, 20000, 1, sa); });
+        std::thread tb([&] { drive(b, 8, 20000, 2, sb); });
+        ta.join();
+        tb.join();
+        seq.stop();
+
+        assert(seq.sequenced() == sa.sent.size() + sb.sent.size());
+        check_against_direct(sa, 7);
+        check_against_direct(sb, 8);
+    }
+
+    // --- Q4: unknown symbol is rejected; stop() finishes what was already submitted ---
+    {
+        BookManager books;
+        books.add_symbol(1);
+        Sequencer seq(books);
+        Sequencer::Producer& p = seq.add_producer();
+        seq.start();
+        assert(p.submit(42, Command{ CommandType::AddLimit, Side::Buy, 10, 5, 1, 0 }));
+        for (int i = 0; i < 100; ++i) assert(p.submit(1, Command{ CommandType::AddLimit, Side::Buy, 10, 1, 2, 0 }));
+        seq.stop();
+        Report r;
+        assert(p.poll(r) && r.type == ReportType::Ack && !r.ack.ok && r.ack.order_id == 0 && r.seq == 1);
+        int n = 0;
+        while (p.poll(r)) { assert(r.type == ReportType::Ack && r.ack.ok); ++n; }
+        assert(n == 100);
+        // books are back in the caller's hands after stop()
+        assert(books.find(1)->depth_at(Side::Buy, 10) == 100);
+    }
+
+    return 0; // success
+}